@@ -0,0 +1,65 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "func.h"
+#include "hashtable.h"
+#include "btree.h"
+
+
+// A probabilistic set that can tell that an element was never added to it,
+// using a few bits per element. Asking whether an element is in the filter
+// either answers no, which is always right, or maybe, which is wrong for a
+// small share of the elements that were never added: the false positive rate.
+// Elements can't be removed, and the filter doesn't store them, only bits set
+// by their hashes.
+
+// The filter is meant to be checked before a search in a larger structure,
+// since most searches for keys that aren't there can then be answered without
+// touching the structure at all. bloom_hash_search and bloom_btree_search do
+// this for a Hashtable and a BTree. The filter must be given every key added
+// to the structure, but keys removed from it can stay in the filter, which
+// only makes their searches a little slower.
+
+// The filter is split into blocks of 64 bytes, the size of a cache line, and
+// all the bits of an element are set in the one block its hash selects. A
+// query reads a single cache line and checks all of its bits at once (with
+// SSE2 instructions when available), instead of reading a different line for
+// every bit. Keeping the bits of an element together raises the false
+// positive rate slightly, which is made up for by using a few more bits per
+// element than an ordinary Bloom filter would.
+
+// The hash function follows the same rules as the one given to hash_init,
+// and must give equal elements equal hashes. The hash function of the table
+// or tree the filter is put in front of can be used.
+
+typedef struct bloom *Bloom;
+
+
+// Initialize a filter for n elements with the given false positive rate and return it, or return NULL in case of failure
+// Rate must be between 0 and 1, rates below 1 in 10^5 are treated as 1 in 10^5
+// Adding more than n elements is allowed, but raises the false positive rate
+Bloom bloom_init(size_t n, double fp_rate, hashFunc hash);
+
+// Return number of elements added to filter, counting elements added more than once every time
+size_t bloom_count(Bloom bloom);
+
+// Return size of filter in bytes, not counting the struct itself
+size_t bloom_bytes(Bloom bloom);
+
+// Add elem to filter
+void bloom_add(Bloom bloom, const void *elem);
+
+// Return false if elem was never added to filter, true if it may have been
+bool bloom_contains(Bloom bloom, const void *elem);
+
+// Remove all elements from filter
+void bloom_clear(Bloom bloom);
+
+// Free memory allocated for filter
+void bloom_destroy(Bloom bloom);
+
+// Return hash_search(table, key), or NULL without searching table if key was never added to filter
+void *bloom_hash_search(Bloom bloom, Hashtable table, void *key);
+
+// Return btree_search(tree, data), or NULL without searching tree if data was never added to filter
+void *bloom_btree_search(Bloom bloom, BTree tree, void *data);
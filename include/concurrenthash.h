@@ -0,0 +1,70 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "func.h"
+
+
+// An unordered map that can be used by multiple threads at the same time,
+// with the same basic operations as the hash table:
+
+// - insert: insert a key-value pair in the table
+// - search: return the value associated with the given key in the table
+// - remove: remove the value associated with the given key from the table
+
+// The table is split into segments, each one a separately chained hash table
+// with its own buckets, its own size and its own read-write lock. A key's
+// segment is chosen by the upper bits of its hash and its bucket by the lower
+// bits. Searches only take the read lock of one segment, so readers never
+// block each other, and insertions and removals only block operations on the
+// same segment. Each segment is resized on its own once its load factor is
+// exceeded, so a resize only stalls threads that use that segment instead of
+// the whole table. The number of segments is set to 64 by default but can be
+// changed at initialization. More segments allow more threads to write at the
+// same time, at the cost of more memory.
+
+// Keys are unique. If a key is inserted into the table when it's already in
+// it, the previous key and value are destroyed and replaced by the new ones.
+
+// THREAD SAFETY: All functions can be called concurrently, except for
+// chash_destroy, which must be called once no other thread uses the table.
+// Values returned by search remain owned by the table. If other threads may
+// replace or remove them while they are being used, set val_destroy to NULL
+// and free values separately once no thread can access them.
+
+// Programs using this table must be linked with -pthread.
+
+typedef struct concurrent_hash *ConcurrentHash;
+
+
+// Initialize a concurrent hash table and return it, or return NULL in case of failure
+// Set destroy to NULL so that elements in table are not destroyed when deletion functions are called
+// Hash and cmp functions are required
+ConcurrentHash chash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
+
+// Initialize a concurrent hash table with given number of segments and return it, or return NULL in case of failure
+// Number of segments must be > 0 and is rounded up to a power of two
+ConcurrentHash chash_init_custom(size_t segments, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
+
+// Return true if table is empty
+bool chash_empty(ConcurrentHash table);
+
+// Return number of elements in table
+size_t chash_size(ConcurrentHash table);
+
+// Insert key-value pair into table, return true if successful
+bool chash_insert(ConcurrentHash table, void *key, void *value);
+
+// Return value associated with key in the table, or NULL if key is not in the table
+void *chash_search(ConcurrentHash table, void *key);
+
+// Remove key and value associated with it from table, return false if key was not in table
+bool chash_remove(ConcurrentHash table, void *key);
+
+// Remove all key-value pairs from table
+void chash_clear(ConcurrentHash table);
+
+// Free memory allocated for table
+void chash_destroy(ConcurrentHash table);
+
+// Return table flag
+int chash_flag(ConcurrentHash table);
@@ -5,7 +5,8 @@ enum str_err_flags
     EMPTY   = 2, // Attempt to access elements of an empty structure
     BOUNDS  = 3, // Index out of bounds
     ARG     = 4, // Invalid argument
-    FUNC    = 5  // Missing necessary function for operation
+    FUNC    = 5, // Missing necessary function for operation
+    HASH    = 6  // Different keys with equal hashes
 };
 
 
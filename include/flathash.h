@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "func.h"
+
+
+// An unordered map where each key is mapped to a value, with the same basic
+// operations as the chained hash table:
+
+// - insert: insert a key-value pair in the table
+// - search: return the value associated with the given key in the table
+// - remove: remove the value associated with the given key from the table
+
+// Unlike the chained hash table, this table is implemented with open
+// addressing. Keys, values and hashes are stored directly in a flat array of
+// slots, so no memory is allocated per element and searches never follow
+// pointers from node to node. Each slot is paired with a control byte that
+// marks it as empty, deleted or full, and full slots keep 7 bits of the key's
+// hash in it. Searching compares the control bytes of 16 slots at a time
+// (with SSE2 instructions when available), and key_cmp is only called for the
+// slots whose 7 hash bits match. The table is resized once 7/8 of its slots
+// are in use, which gives constant time on average for all operations.
+
+// Keys are unique. If a key is inserted into the table when it's already in
+// it, the previous key and value are destroyed and replaced by the new ones.
+// The hash, cmp and destroy functions follow the same rules as the ones
+// given to hash_init, so a Hashtable can be swapped for a FlatHash without
+// changing them.
+
+typedef struct flathash *FlatHash;
+
+
+// Initialize a flat hash table and return it, or return NULL in case of failure
+// Set destroy to NULL so that elements in table are not destroyed when deletion functions are called
+// Hash and cmp functions are required
+FlatHash flathash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
+
+// Return true if table is empty
+bool flathash_empty(FlatHash table);
+
+// Return number of elements in table
+size_t flathash_size(FlatHash table);
+
+// Return number of slots in table
+size_t flathash_capacity(FlatHash table);
+
+// Insert key-value pair into table, return true if successful
+bool flathash_insert(FlatHash table, void *key, void *value);
+
+// Return value associated with key in the table, or NULL if key is not in the table
+void *flathash_search(FlatHash table, void *key);
+
+// Remove key and value associated with it from table, return false if key was not in table
+bool flathash_remove(FlatHash table, void *key);
+
+// Remove all key-value pairs from table, return true if successful
+bool flathash_clear(FlatHash table);
+
+// Free memory allocated for table
+void flathash_destroy(FlatHash table);
+
+// Change key-destroy function for table
+void flathash_set_key_destroy(FlatHash table, destroyFunc key_destroy);
+
+// Change value-destroy function for table
+void flathash_set_val_destroy(FlatHash table, destroyFunc val_destroy);
+
+// Return table flag
+int flathash_flag(FlatHash table);
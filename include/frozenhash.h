@@ -0,0 +1,58 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "func.h"
+
+
+// An immutable map built once from a set of key-value pairs and then only
+// searched. It's meant for tables that are filled at startup and never
+// changed afterwards, such as configuration or dictionaries.
+
+// Keys are placed with a minimal perfect hash function, built with the
+// hash-and-displace method: keys are split into small buckets by their hash,
+// and every bucket is given a displacement value that sends all of its keys to
+// slots no other key uses. Every key gets its own slot and there are exactly
+// as many slots as keys, so there are no empty slots and no chains. A search
+// hashes the key, reads the displacement of its bucket and compares the key in
+// the one slot it can be in. Displacements are searched among 1% more
+// positions than there are slots, which makes building much faster, and the
+// few keys placed past the last slot are sent to the slots left free with one
+// more read. Each pair takes the two pointers of its slot plus about one byte
+// of displacements, which is much less than a node of the chained hash table
+// and its share of the bucket array.
+
+// Building takes linear time on average. The table can be built from arrays
+// of keys and values, or from a Hashtable with hash_freeze. Keys must be
+// unique and the hash function must give different keys different hashes,
+// since keys with the same hash can't be sent to different slots. Otherwise,
+// the hash, cmp and destroy functions follow the same rules as the ones given
+// to hash_init.
+
+typedef struct frozen_hash *FrozenHash;
+
+// Function called for every key-value pair by frozen_foreach, ctx is passed through unchanged
+typedef void (*frozenForeachFunc)(void *key, void *value, void *ctx);
+
+
+// Build a frozen table of n key-value pairs and return it, or return NULL in case of failure or duplicate keys
+// Values can be NULL, in which case every key is associated with NULL
+// The table takes ownership of the keys and values, but not of the arrays that hold them
+FrozenHash frozen_init(void **keys, void **values, size_t n, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
+
+// Return true if table is empty
+bool frozen_empty(FrozenHash table);
+
+// Return number of elements in table
+size_t frozen_size(FrozenHash table);
+
+// Return value associated with key in the table, or NULL if key is not in the table
+void *frozen_search(FrozenHash table, void *key);
+
+// Call fn for every key-value pair in table, in no particular order
+void frozen_foreach(FrozenHash table, frozenForeachFunc fn, void *ctx);
+
+// Free memory allocated for table
+void frozen_destroy(FrozenHash table);
+
+// Return table flag
+int frozen_flag(FrozenHash table);
@@ -1,3 +1,5 @@
+#include <stdint.h>
+
 // FUNCTIONS USED BY THE DATA STRUCTURES
 
 // Free all memory allocated for element. When NULL is passed to the 
@@ -32,4 +34,11 @@ typedef void *(*copyFunc)(const void *);
 // Hash element to an unsigned integer.
 // This function is required for the hash table. It cannot be NULL.
 
-typedef size_t (*hashFunc)(const void *);
\ No newline at end of file
+typedef size_t (*hashFunc)(const void *);
+
+// Return an unsigned 64-bit integer key of element, by which elements are
+// sorted in ascending order. For signed keys, flip the sign bit of the key so
+// that negative keys come first.
+// This function is required for sorting by integer keys. It cannot be NULL.
+
+typedef uint64_t (*keyFunc)(const void *);
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+
+
+// HASH FUNCTIONS FOR COMMON KEY TYPES
+
+// Every function below except hash_bytes can be passed directly as the hashFunc
+// of a hash table. Each one receives a pointer to the key, apart from hash_ptr,
+// which hashes the pointer itself.
+
+// Strings and memory blocks are hashed with a function based on wyhash, which
+// reads the input 8 or 16 bytes at a time and mixes it with 128-bit
+// multiplications. Integers are mixed with the finalizer of murmur3, so that
+// every bit of the key affects every bit of the hash. All of these give
+// well-distributed hashes that can be used with either capacity policy of the
+// hash table.
+
+
+// Hash len bytes starting at data, different seeds give unrelated hashes
+size_t hash_bytes(const void *data, size_t len, size_t seed);
+
+// Hash a NUL-terminated string
+size_t hash_str(const void *str);
+
+// Hash an int
+size_t hash_int(const void *num);
+
+// Hash a 32-bit unsigned integer
+size_t hash_u32(const void *num);
+
+// Hash a 64-bit unsigned integer
+size_t hash_u64(const void *num);
+
+// Hash a pointer by its address, for keys that are compared by identity
+size_t hash_ptr(const void *ptr);
+
+// Hash a memory block of 8 bytes
+size_t hash_mem8(const void *data);
+
+// Hash a memory block of 16 bytes
+size_t hash_mem16(const void *data);
+
+// Hash a memory block of 32 bytes
+size_t hash_mem32(const void *data);
+
+// Hash a memory block of 64 bytes
+size_t hash_mem64(const void *data);
+
+// Mix bits of a 64-bit integer so that every bit of the input affects every bit of the output
+// Defined here so that hash tables can inline it when mixing the hashes of their keys
+static inline size_t hash_mix64(uint64_t num)
+{
+    num ^= num >> 33;
+    num *= 0xff51afd7ed558ccdULL;
+    num ^= num >> 33;
+    num *= 0xc4ceb9fe1a85ec53ULL;
+    num ^= num >> 33;
+
+    return num;
+}
+
+// Return a random seed for hash functions, read from the operating system's random number generator
+// Falls back to mixing the time, a stack address and a counter only if the generator can't be read
+size_t hash_random_seed(void);
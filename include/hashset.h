@@ -0,0 +1,88 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "func.h"
+#include "hashtable.h"
+
+
+// An unordered set of unique keys, with the following basic operations:
+
+// - add: add a key to the set
+// - contains: return true if the given key is in the set
+// - remove: remove the given key from the set
+
+// The set is a hash table without values. It shares its implementation with
+// the hash table, so it's resized, rehashed, seeded and protected against
+// long chains the same way, and it supports both capacity policies. Its nodes
+// are allocated without a value field, so each element takes 8 bytes less than
+// a hash table that stores NULL values.
+
+// Union, intersection and difference return a new set and leave their operands
+// unchanged. Intersection searches the larger set for every key of the smaller
+// one. Union adds the keys of the larger set without searching for them and
+// only searches for keys of the smaller one. Difference has to visit every key
+// of the first set. Keys of the result are copied with the given copy function,
+// in which case the result destroys them with the key-destroy function of the
+// first set. If copy is NULL, the result holds the same pointers as the
+// operands and doesn't destroy them. Both sets should use the same hash and cmp
+// functions.
+
+// If a key is added to the set when an equal key is already in it, the
+// previous key is destroyed and replaced by the new one.
+
+typedef struct hashset *HashSet;
+
+// Function called for every key by hashset_foreach, ctx is passed through unchanged
+typedef void (*hashsetForeachFunc)(void *key, void *ctx);
+
+
+// Initialize a hash set and return it, or return NULL in case of failure
+// Set destroy to NULL so that keys in set are not destroyed when deletion functions are called
+// Hash and cmp functions are required
+HashSet hashset_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy);
+
+// Initialize a hash set with given capacity policy and return it, or return NULL in case of failure
+HashSet hashset_init_custom(HashPolicy policy, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy);
+
+// Return true if set is empty
+bool hashset_empty(HashSet set);
+
+// Return number of keys in set
+size_t hashset_size(HashSet set);
+
+// Add key to set, return true if successful
+bool hashset_add(HashSet set, void *key);
+
+// Return true if key is in set
+bool hashset_contains(HashSet set, void *key);
+
+// Remove key from set, return false if key was not in set
+bool hashset_remove(HashSet set, void *key);
+
+// Resize set so that it can hold n keys without resizing again, return true if successful
+bool hashset_reserve(HashSet set, size_t n);
+
+// Return a new set with the keys that are in a or b, or NULL in case of failure
+HashSet hashset_union(HashSet a, HashSet b, copyFunc copy);
+
+// Return a new set with the keys that are in both a and b, or NULL in case of failure
+HashSet hashset_intersection(HashSet a, HashSet b, copyFunc copy);
+
+// Return a new set with the keys of a that are not in b, or NULL in case of failure
+HashSet hashset_difference(HashSet a, HashSet b, copyFunc copy);
+
+// Call fn for every key in set, in no particular order
+// Set must not be changed by fn
+void hashset_foreach(HashSet set, hashsetForeachFunc fn, void *ctx);
+
+// Remove all keys from set, return true if successful
+bool hashset_clear(HashSet set);
+
+// Free memory allocated for set
+void hashset_destroy(HashSet set);
+
+// Change key-destroy function for set
+void hashset_set_key_destroy(HashSet set, destroyFunc key_destroy);
+
+// Return set flag
+int hashset_flag(HashSet set);
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdbool.h>
+#include <stdlib.h>
+#include "hashtable.h"
+
+
+// A read-only copy of a hash table stored in a file, which can be searched
+// straight from a memory mapping of the file.
+
+// hash_save writes the key-value pairs of a table to a file, turning each key
+// and value into bytes with the given encode functions. snapshot_open maps the
+// file into memory and snapshot_search looks keys up in the mapping, so
+// opening a snapshot allocates nothing per element and reads nothing up front:
+// each page of the file is only loaded the first time a search touches it.
+// The file only holds offsets from its start, so it can be mapped at any
+// address or copied between processes and machines of the same byte order.
+
+// The file starts with a header, followed by an array of bucket offsets and
+// then by the entries of every bucket, one bucket after the other. Each entry
+// holds the hash of the key, the lengths of the key and value, and their
+// bytes. Keys are hashed with hash_bytes and a seed stored in the header, and
+// are compared with memcmp. This means that searches take the encoded key,
+// which must be encoded the same way as the keys that were saved. Values are
+// returned as pointers into the mapping, aligned to 8 bytes, and stay valid
+// until the snapshot is closed.
+
+typedef struct hash_snapshot *HashSnapshot;
+
+// Encode elem into buf if size is large enough for it, and return the length of the encoding either way
+// buf is NULL when only the length is needed
+typedef size_t (*encodeFunc)(const void *elem, void *buf, size_t size);
+
+
+// Write key-value pairs of table to the file at path, return true if successful
+// Both encode functions are required, table must not be changed while it's saved
+// An existing file at path is only replaced once the new one is complete, and is left unchanged if saving fails
+bool hash_save(Hashtable table, const char *path, encodeFunc key_encode, encodeFunc val_encode);
+
+// Map snapshot file at path into memory and return it, or return NULL if it can't be opened or is not a valid snapshot
+HashSnapshot snapshot_open(const char *path);
+
+// Return number of elements in snapshot
+size_t snapshot_size(HashSnapshot snap);
+
+// Return pointer to the encoded value associated with the encoded key, or NULL if key is not in the snapshot
+// Set val_len to length of the value (val_len can be NULL)
+const void *snapshot_search(HashSnapshot snap, const void *key, size_t key_len, size_t *val_len);
+
+// Unmap snapshot and free memory allocated for it
+void snapshot_close(HashSnapshot snap);
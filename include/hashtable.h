@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "func.h"
+#include "frozenhash.h"
 
 
 // An unordered map where each key is mapped to a value. Keys are used to
@@ -24,18 +25,115 @@
 // but can be changed. For a faster performance that uses more space, you can
 // lower the load factor, but if space is an issue a higher load factor is better.
 
+// Rehashing normally moves every element at once, so the insertion that
+// triggers it takes linear time. If the table is set to be incremental, the
+// previous bucket array is kept after resizing and a few of its buckets are
+// moved to the new array on every insertion, search and removal, until the
+// previous array is empty. Searches check both arrays in the meantime. This
+// keeps every operation short at the cost of some extra work per operation
+// while a rehash is in progress.
+
+// Large tables can also be rehashed by several threads at once, by allowing
+// more than one thread with hash_set_threads. The buckets of the previous
+// array are then split between the threads of a shared pool (see
+// threadpool.h), which insert the elements they move at the head of their new
+// buckets atomically. Tables with fewer than 65536 elements and incremental
+// tables are always rehashed by one thread. Programs that allow more than one
+// thread must be linked with -pthread.
+
+// By default the number of buckets is a prime number and a key's bucket is
+// its hash modulo the number of buckets, which spreads keys well even with
+// weak hash functions. Tables can instead be initialized with a power of two
+// policy, where the bucket is found by masking the hash instead. This avoids a
+// division on every operation.
+
+// Every table picks a random seed when it's initialized. The output of the
+// hash function is combined with the seed and mixed so that all of its bits
+// affect the lower ones, so keys can't be chosen in advance to land in the
+// same bucket. Keys whose hashes are fully equal still collide, so a bucket
+// whose chain grows longer than 8 nodes is also given a Red-Black Tree of its
+// nodes, ordered by hash and then by the cmp function. Searches in that bucket
+// take logarithmic time, which keeps the worst case of searching and
+// insertion at O(log n). Removing a key from such a bucket still walks its
+// chain to unlink the node. For trees to work, the cmp function must order
+// keys as described in func.h, not just tell whether they are equal.
+
+// The table also shrinks once most of its elements have been removed, so that
+// operations that go through every bucket don't scan mostly empty ones. It
+// shrinks when it holds fewer than a quarter of the elements that would make
+// it grow, and its new capacity leaves it half as full as the load factor
+// allows. That way, insertions and removals around either limit don't keep
+// resizing the table. Shrinking can be disabled.
+
+// Nodes that hold the key-value pairs are allocated from large blocks of
+// memory owned by the table instead of one at a time. Nodes of removed pairs
+// are reused by later insertions, and the blocks are only released when the
+// table is cleared or destroyed.
+
+// Tables that are only searched once they are filled can be turned into a
+// FrozenHash with hash_freeze, which uses a minimal perfect hash function and
+// much less memory. See frozenhash.h.
+
+// hash_stats reports how the elements are spread over the buckets, along with
+// counters kept by the table: the number of nodes visited by successful and
+// unsuccessful searches, including the ones done by insertions to find out if
+// the key is already in the table, and the number of rehashes and the time
+// they took. Searching a bucket that has a tree counts as one node. Keeping
+// the counters costs a few additions per operation and two clock reads per
+// rehash. If the library is compiled with HASH_NO_STATS defined, they are left
+// out entirely and always read as zero.
+
 // Since this hash table is implemented as a map, keys are unique. If a key is
 // inserted into the table when it's already in it, the previous value associated
 // with it is destroyed and replaced by the new one.
 
 typedef struct hashtable *Hashtable;
 
+// Iterator over the key-value pairs of a hash table
+typedef struct hash_iter *HashIter;
+
+// Function called for every key-value pair by hash_foreach, ctx is passed through unchanged
+typedef void (*hashForeachFunc)(void *key, void *value, void *ctx);
+
+// Policy for the number of buckets in the table
+typedef enum hash_policy
+{
+    HASH_PRIME,  // Prime number of buckets, index is hash modulo number of buckets
+    HASH_POW2    // Power of two buckets, index is mixed hash masked to number of buckets
+}
+HashPolicy;
+
+// Number of entries in the chain length histogram of HashStats
+#define HASH_STATS_CHAINS 16
+
+// Statistics of a hash table, filled by hash_stats
+typedef struct hash_stats
+{
+    size_t size;                        // Number of elements
+    size_t capacity;                    // Number of buckets
+    size_t used_buckets;                // Number of buckets with at least one element
+    size_t max_chain;                   // Length of the longest chain
+    size_t tree_buckets;                // Number of buckets that have a tree
+    size_t chains[HASH_STATS_CHAINS];   // Number of buckets with each chain length, the last entry counts all longer chains
+    size_t hits;                        // Number of searches that found their key
+    size_t misses;                      // Number of searches that didn't find their key
+    double hit_probes;                  // Average number of nodes visited by a search that found its key
+    double miss_probes;                 // Average number of nodes visited by a search that didn't find its key
+    size_t rehashes;                    // Number of times table was resized
+    double rehash_time;                 // Time spent rehashing, in seconds
+}
+HashStats;
+
 
 // Initialize a hash table and return it, or return NULL in case of failure
 // Set destroy to NULL so that elements in table are not destroyed when deletion functions are called
 // Hash and cmp functions are required
 Hashtable hash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
 
+// Initialize a hash table with given capacity policy and return it, or return NULL in case of failure
+// Hash table initialized by hash_init uses HASH_PRIME policy
+Hashtable hash_init_custom(HashPolicy policy, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy);
+
 // Return true if hash table is empty
 bool hash_empty(Hashtable table);
 
@@ -45,18 +143,53 @@ size_t hash_size(Hashtable table);
 // Insert key-value pair into hash table, return true if successful
 bool hash_insert(Hashtable table, void *key, void *value);
 
+// Insert n key-value pairs into hash table, return true if successful
+// Table is resized at most once and keys are hashed in batches, so this is faster than inserting pairs one by one
+// If memory can't be allocated, pairs before the one that failed remain in the table
+bool hash_insert_bulk(Hashtable table, void **keys, void **values, size_t n);
+
+// Resize table so that it can hold n elements without resizing again, return true if successful
+// If no capacity can hold n elements, structure is flagged with ERR_ARG
+bool hash_reserve(Hashtable table, size_t n);
+
+// Return pointer to the value associated with key, inserting key with a NULL value if it's not in table
+// The value can be read and replaced through the pointer, which stays valid until key is removed
+// If key was already in table, it's not stored again and the caller keeps ownership of the key passed
+// Set inserted to true if key was inserted (inserted can be NULL), return NULL in case of failure
+void **hash_upsert(Hashtable table, void *key, bool *inserted);
+
+// Return value associated with key, or insert key-value pair and return value if key is not in table
+// If key was already in table, neither key nor value are stored and the caller keeps ownership of them
+// Return NULL in case of failure
+void *hash_get_or_insert(Hashtable table, void *key, void *value);
+
 // Return value associated with key in the hash table, or NULL if key is not in the table
 void *hash_search(Hashtable table, void *key);
 
+// Search for n keys at once and store value associated with each one in values, or NULL if key is not in table
+// Memory accesses of different keys are overlapped, so this is faster than searching for keys one by one
+// Return number of keys found in table
+size_t hash_search_batch(Hashtable table, void **keys, size_t n, void **values);
+
 // Remove key and value associated with it from hash table, return false if key was not in table
 bool hash_remove(Hashtable table, void *key);
 
 // Remove all key-value pairs from hash table, return true if successful
+// Table returns to its initial capacity
 bool hash_clear(Hashtable table);
 
+// Remove all key-value pairs from hash table without changing its capacity
+void hash_clear_keep_capacity(Hashtable table);
+
+// Shrink table to smallest capacity that can hold its elements, return true if successful
+bool hash_shrink_to_fit(Hashtable table);
+
 // Free memory allocated for table
 void hash_destroy(Hashtable table);
 
+// Return number of buckets in hash table
+size_t hash_capacity(Hashtable table);
+
 // Return hash table load factor
 double hash_load_factor(Hashtable table);
 
@@ -69,5 +202,57 @@ void hash_set_val_destroy(Hashtable table, destroyFunc val_destroy);
 // Change load factor for hash table and resize according to new load factor, return true if successful
 bool hash_set_load_factor(Hashtable table, double load_factor);
 
+// Set whether table is rehashed incrementally, incremental rehashing is disabled by default
+// If it's disabled while a rehash is in progress, the rehash is completed
+void hash_set_incremental(Hashtable table, bool incremental);
+
+// Return true if table is rehashed incrementally
+bool hash_incremental(Hashtable table);
+
+// Set maximum number of threads that move elements when table is rehashed, including the calling thread
+// Only one thread is used by default, 0 is treated as 1
+void hash_set_threads(Hashtable table, size_t threads);
+
+// Store statistics of table in stats
+// Buckets not yet moved by an incremental rehash are counted along with the current ones
+void hash_stats(Hashtable table, HashStats *stats);
+
+// Reset search and rehash counters of table to zero
+void hash_reset_stats(Hashtable table);
+
+// Call fn for every key-value pair in table, in no particular order
+// Table must not be changed by fn
+void hash_foreach(Hashtable table, hashForeachFunc fn, void *ctx);
+
+// Return an iterator positioned before the first key-value pair of table, or NULL in case of failure
+// While iterating, the table must only be changed through hash_iter_remove
+HashIter hash_iter_begin(Hashtable table);
+
+// Move iterator to the next key-value pair and store its key and value (either can be NULL)
+// Return false if there are no more pairs
+bool hash_iter_next(HashIter iter, void **key, void **value);
+
+// Remove and destroy key-value pair iterator is at, return true if successful
+// Iteration continues with the next pair
+bool hash_iter_remove(HashIter iter);
+
+// Free memory allocated for iterator
+void hash_iter_destroy(HashIter iter);
+
+// Build a frozen table with the key-value pairs of table and return it, or return NULL in case of failure
+// The frozen table takes ownership of the elements and table is left empty, but can still be used
+// If building fails, table is left unchanged, and if two of its keys have equal hashes it is flagged with ERR_HASH
+FrozenHash hash_freeze(Hashtable table);
+
+// Give table a new random seed and rehash every element, return true if successful
+// Useful if the seed may have leaked, for example through the iteration order of the table
+bool hash_randomize(Hashtable table);
+
+// Set whether table shrinks automatically after removals, shrinking is enabled by default
+void hash_set_shrink(Hashtable table, bool shrink);
+
+// Return capacity policy of hash table
+HashPolicy hash_policy(Hashtable table);
+
 // Return hash table flag
 int hash_flag(Hashtable table);
\ No newline at end of file
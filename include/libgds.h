@@ -1,11 +1,20 @@
 // Definitions of functions commonly required for data structures
 #include "func.h"
 
+// Hash functions for common key types
+#include "hashfunc.h"
+
 // Definitions and prototypes for data structures
 #include "stack.h"
 #include "queue.h"
-#include "vector"
+#include "vector.h"
 #include "list.h"
 #include "pq.h"
 #include "hashtable.h"
-#include "btree.h"
\ No newline at end of file
+#include "hashset.h"
+#include "frozenhash.h"
+#include "hashsnapshot.h"
+#include "flathash.h"
+#include "concurrenthash.h"
+#include "btree.h"
+#include "bloom.h"
\ No newline at end of file
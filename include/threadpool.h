@@ -0,0 +1,27 @@
+#pragma once
+#include <stdlib.h>
+
+
+// A pool of worker threads shared by the data structures that can split their
+// work between threads, such as the parallel rehash of the hash table and the
+// parallel sort of the vector.
+
+// The pool is started the first time it's needed, with one worker for every
+// online processor but one, and its workers live until the program exits.
+// Work is given to the pool as a number of independent tasks. The calling
+// thread runs tasks too and returns once all of them have finished. Only one
+// caller uses the workers at a time. If they're busy, for example when a task
+// itself asks for more tasks to be run, the tasks run on the calling thread.
+
+// Programs using the pool must be linked with -pthread.
+
+// Function that runs task number task, ctx is passed through unchanged
+typedef void (*taskFunc)(void *ctx, size_t task);
+
+
+// Run fn for every task from 0 to ntasks - 1 on up to nthreads threads, including the calling thread
+// Return once every task has finished
+void threadpool_run(size_t ntasks, size_t nthreads, taskFunc fn, void *ctx);
+
+// Return number of threads that can run tasks at once, including the calling thread
+size_t threadpool_threads(void);
@@ -36,6 +36,9 @@
 
 typedef struct vector *Vector;
 
+// Read-only copy of a sorted vector, laid out for fast searching (see vector_eytzinger)
+typedef struct eytzinger *Eytzinger;
+
 
 
 // Initialize a vector and return it, or return NULL in case of failure
@@ -81,6 +84,15 @@ bool vector_append(Vector vector, void *data);
 // You cannot insert in an empty vector or after the last element. Use append for those insertions.
 bool vector_insert(Vector vector, void *data, size_t index);
 
+// Insert k elements of items after last element of vector, return true if successful
+// Vector grows at most once, so this is faster than appending elements one by one
+bool vector_append_array(Vector vector, void **items, size_t k);
+
+// Insert k elements of items before element at index of vector, return true if successful
+// Index can be equal to size, in which case elements are appended
+// Vector grows at most once and elements after index are shifted once, however many elements are inserted
+bool vector_insert_range(Vector vector, size_t index, void **items, size_t k);
+
 // Remove and destroy first element of vector, return true if successful
 bool vector_remove_first(Vector vector);
 
@@ -93,6 +105,10 @@ bool vector_remove_at(Vector vector, size_t index);
 // Remove and destroy all instances of data in vector, return true if successful (requires cmp func)
 bool vector_remove_all(Vector vector, void *data, cmpFunc cmp);
 
+// Remove and destroy elements from index at start to index at end-1, where start <= end <= size, return true if successful
+// Elements after the range are shifted once, and the array is reallocated at most once
+bool vector_erase_range(Vector vector, size_t start, size_t end);
+
 // Remove and return first element of vector, NULL in case of failure
 void *vector_pop_first(Vector vector);
 
@@ -125,19 +141,82 @@ void vector_reverse(Vector vector);
 bool vector_trim(Vector vector, size_t start, size_t end);
 
 // Sort vector, return true if successful (requires cmp func)
+// Worst case is O(n log n), and input that is already sorted or in descending order takes linear time
 bool vector_sort(Vector vector, cmpFunc cmp);
 
+// Sort vector on up to nthreads threads, including the calling thread, return true if successful (requires cmp func)
+// Vectors with fewer than 65536 elements are sorted by one thread, 0 threads is treated as 1
+// Programs that use more than one thread must be linked with -pthread (see threadpool.h)
+bool vector_sort_parallel(Vector vector, cmpFunc cmp, size_t nthreads);
+
+// Sort vector in ascending order of the integer key of every element, return true if successful (requires key func)
+// Key func is called once per element and elements are sorted by radix sort in linear time
+// Sort is stable, elements with equal keys keep their order
+bool vector_sort_by_u64_key(Vector vector, keyFunc key);
+
+// Sort vector so that equal elements keep their order, return true if successful (requires cmp func)
+// Runs that are already sorted are merged as they are, so nearly sorted input takes close to linear time
+// Uses a buffer of half the size of the vector, if it can't be allocated vector remains the same
+bool vector_stable_sort(Vector vector, cmpFunc cmp);
+
+// Move element that belongs at index in sorted order there, return true if successful (requires cmp func)
+// Elements before index are not greater than it and elements after it are not smaller, in no particular order
+// Takes linear time on average
+bool vector_nth_element(Vector vector, size_t index, cmpFunc cmp);
+
+// Sort the smallest k elements of vector into its first k positions, return true if successful (requires cmp func)
+// Remaining elements follow in no particular order, if k >= size the whole vector is sorted
+// Takes O(n + k log k) time on average
+bool vector_partial_sort(Vector vector, size_t k, cmpFunc cmp);
+
+// Return a sorted array of the smallest k elements of vector, or NULL in case of failure (requires cmp func)
+// Must be 0 < k <= size, vector is not changed and array must be freed by the caller
+// Elements are passed through a heap of k elements in one pass, which takes O(n log k) time
+void **vector_top_k(Vector vector, size_t k, cmpFunc cmp);
+
+// Return index of first element of sorted vector that is not smaller than data, or size if there is none
+// Return __SIZE_MAX__ in case of failure (requires cmp func)
+// Searches compare the same number of times for every key and don't branch on the result of cmp
+size_t vector_lower_bound(Vector vector, void *data, cmpFunc cmp);
+
+// Return index of first element of sorted vector that is greater than data, or size if there is none
+// Return __SIZE_MAX__ in case of failure (requires cmp func)
+size_t vector_upper_bound(Vector vector, void *data, cmpFunc cmp);
+
+// Store in start and end the range of indexes of sorted vector whose elements are equal to data (either can be NULL)
+// Return true if there is at least one such element (requires cmp func)
+bool vector_equal_range(Vector vector, void *data, cmpFunc cmp, size_t *start, size_t *end);
+
 // Return index of data in vector, __SIZE_MAX__ in case of failure (requires cmp func)
 // If vector is unsorted, behavior is undefined
-// Vector must contain data exactly once or any index containing data could be returned
+// If vector contains data more than once, index of the first instance is returned
 // If it doesn't contain data, structure is flagged with ERR_ARG
 size_t vector_binary_search(Vector vector, void *data, cmpFunc cmp);
 
-// Insert data in sorted manner, return true if successful
+// Insert data in sorted manner, after any elements equal to it, return true if successful
 // If initial vector is unsorted, behavior is undefined
-// Every insertion takes logarithmic time, so this is much slower than appending every element and then sorting
+// Every insertion takes linear time, so this is much slower than appending every element and then sorting
 bool vector_insert_sorted(Vector vector, void *data, cmpFunc cmp);
 
+// Return a copy of sorted vector in Eytzinger layout, or NULL in case of failure
+// Elements are stored in breadth-first order of a complete binary search tree, so the first levels of every
+// search share the same few cache lines and the nodes a search visits next can be prefetched
+// Elements are not copied and the copy doesn't change with the vector, so it's meant for vectors that are no longer changed
+Eytzinger vector_eytzinger(Vector vector);
+
+// Return number of elements in Eytzinger copy
+size_t eytzinger_size(Eytzinger eytz);
+
+// Return element of Eytzinger copy that is equal to data, or NULL if there is none
+// Cmp func must be the one vector was sorted with
+void *eytzinger_search(Eytzinger eytz, void *data, cmpFunc cmp);
+
+// Return first element of Eytzinger copy that is not smaller than data, or NULL if there is none
+void *eytzinger_lower_bound(Eytzinger eytz, void *data, cmpFunc cmp);
+
+// Free memory allocated for Eytzinger copy, elements are not destroyed
+void eytzinger_destroy(Eytzinger eytz);
+
 // Return a deep copy of vector if copy func is given or a shallow copy if copy func is NULL
 // Return NULL in case of failure
 Vector vector_copy(Vector vector, copyFunc copy);
@@ -0,0 +1,191 @@
+#include "../include/bloom.h"
+#include "../include/hashfunc.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BLOCK_BYTES 64                      // Size of a block, one cache line
+#define BLOCK_WORDS (BLOCK_BYTES / 4)       // Number of 32-bit words in a block
+#define MAX_BITS 16                         // Maximum number of bits set per element
+#define MIN_RATE 1e-5                       // Lower rates would need more than MAX_BITS bits
+#define BLOCK_OVERHEAD 1.2                  // Extra bits per element that make up for keeping bits in one block
+#define LN2 0.6931471805599453
+
+typedef uint32_t block[BLOCK_WORDS];
+
+struct bloom
+{
+    block *blocks;        // Array of blocks, aligned to a cache line
+    size_t nblocks;       // Number of blocks
+    int bits;             // Number of bits set per element
+    size_t count;         // Number of elements added
+    hashFunc hash;
+};
+
+// Odd multipliers that turn one 32-bit hash into a different bit position each
+static const uint32_t salts[MAX_BITS] =
+{
+    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31,
+    0x6a09e667, 0xbb67ae85, 0x3c6ef373, 0xa54ff53b, 0x510e527f, 0x9b05688d, 0x1f83d9ab, 0x5be0cd19
+};
+
+
+
+//////////////////////////////////////// HELPER FUNCTIONS //////////////////////////////////////////
+
+// Return block that element with given hash sets its bits in
+// Upper 32 bits of hash are scaled to the number of blocks, which avoids a division
+static inline uint32_t *hash_block(Bloom bloom, uint64_t hash)
+{
+    return bloom->blocks[((hash >> 32) * bloom->nblocks) >> 32];
+}
+
+// Fill mask with the bits of an element with given hash, one word per 32 bits of the block
+// Every bit is picked by the upper 9 bits of the lower half of the hash times a salt
+static inline void hash_mask(Bloom bloom, uint64_t hash, uint32_t *mask)
+{
+    uint32_t h = hash;
+    memset(mask, 0, BLOCK_BYTES);
+
+    for (int i = 0; i < bloom->bits; i++)
+    {
+        uint32_t x = h * salts[i];
+        mask[x >> 28] |= (uint32_t) 1 << ((x >> 23) & 31);
+    }
+}
+
+// Return true if every bit of mask is set in block
+static inline bool block_test(const uint32_t *blk, const uint32_t *mask)
+{
+#ifdef __SSE2__
+    // Bits of mask missing from block are collected in 16 words at a time
+    __m128i missing = _mm_setzero_si128();
+
+    for (int i = 0; i < BLOCK_WORDS; i += 4)
+    {
+        __m128i b = _mm_load_si128((const __m128i *) (blk + i));
+        __m128i m = _mm_loadu_si128((const __m128i *) (mask + i));
+        missing = _mm_or_si128(missing, _mm_andnot_si128(b, m));
+    }
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint32_t missing = 0;
+
+    for (int i = 0; i < BLOCK_WORDS; i++)
+        missing |= mask[i] & ~blk[i];
+
+    return !missing;
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+Bloom bloom_init(size_t n, double fp_rate, hashFunc hash)
+{
+    if (!hash || !(fp_rate > 0 && fp_rate < 1))
+        return NULL;
+
+    if (fp_rate < MIN_RATE) fp_rate = MIN_RATE;
+
+    Bloom bloom = malloc(sizeof(struct bloom));
+    if (!bloom) return NULL;
+
+    // An ordinary filter is smallest when each element sets log2(1 / rate) bits and takes 1 / ln 2 times as many bits of memory
+    int bits = 1;
+    for (double rate = 0.5; rate > fp_rate && bits < MAX_BITS; rate /= 2)
+        bits++;
+
+    double bits_per_elem = bits / LN2 * BLOCK_OVERHEAD;
+
+    bloom->bits = bits;
+    bloom->nblocks = n * bits_per_elem / (BLOCK_BYTES * 8) + 1;
+
+    // Block index is scaled from 32 bits of the hash
+    if (bloom->nblocks > UINT32_MAX) bloom->nblocks = UINT32_MAX;
+
+    bloom->blocks = aligned_alloc(BLOCK_BYTES, bloom->nblocks * BLOCK_BYTES);
+
+    if (!bloom->blocks)
+    {
+        free(bloom);
+        return NULL;
+    }
+
+    memset(bloom->blocks, 0, bloom->nblocks * BLOCK_BYTES);
+    bloom->count = 0;
+    bloom->hash = hash;
+
+    return bloom;
+}
+
+size_t bloom_count(Bloom bloom)
+{
+    return bloom->count;
+}
+
+size_t bloom_bytes(Bloom bloom)
+{
+    return bloom->nblocks * BLOCK_BYTES;
+}
+
+void bloom_add(Bloom bloom, const void *elem)
+{
+    uint64_t hash = hash_mix64(bloom->hash(elem));
+    uint32_t mask[BLOCK_WORDS];
+
+    hash_mask(bloom, hash, mask);
+
+    uint32_t *blk = hash_block(bloom, hash);
+
+    for (int i = 0; i < BLOCK_WORDS; i++)
+        blk[i] |= mask[i];
+
+    bloom->count++;
+}
+
+bool bloom_contains(Bloom bloom, const void *elem)
+{
+    uint64_t hash = hash_mix64(bloom->hash(elem));
+    uint32_t *blk = hash_block(bloom, hash);
+
+    // Block is loaded while the mask is built
+    __builtin_prefetch(blk);
+
+    uint32_t mask[BLOCK_WORDS];
+    hash_mask(bloom, hash, mask);
+
+    return block_test(blk, mask);
+}
+
+void bloom_clear(Bloom bloom)
+{
+    memset(bloom->blocks, 0, bloom->nblocks * BLOCK_BYTES);
+    bloom->count = 0;
+}
+
+void bloom_destroy(Bloom bloom)
+{
+    free(bloom->blocks);
+    free(bloom);
+}
+
+void *bloom_hash_search(Bloom bloom, Hashtable table, void *key)
+{
+    if (!bloom_contains(bloom, key))
+        return NULL;
+
+    return hash_search(table, key);
+}
+
+void *bloom_btree_search(Bloom bloom, BTree tree, void *data)
+{
+    if (!bloom_contains(bloom, data))
+        return NULL;
+
+    return btree_search(tree, data);
+}
@@ -0,0 +1,358 @@
+#include "../include/concurrenthash.h"
+#include "../include/flags.h"
+#include "../include/hashfunc.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#define SEGMENTS 64           // Default number of segments
+#define MAX_SEGMENTS 65536    // Segments are chosen by the upper 16 bits of the hash
+#define SEGMENT_SHIFT (sizeof(size_t) * CHAR_BIT - 16)  // Shift that leaves the upper 16 bits of a hash
+#define MIN_CAPACITY 16       // Initial number of buckets of each segment
+#define LOAD_FACTOR 0.75
+#define CACHE_LINE 64
+
+typedef struct node *Node;
+
+typedef struct node
+{
+    void *key;            // Key stored in node
+    void *value;          // Value associated with the key
+    size_t hash;          // Mixed hash of the key
+    Node next;            // Pointer to next node in list
+}
+node;
+
+// Each segment sits on its own cache lines so that threads locking
+// neighbouring segments don't slow each other down
+typedef struct segment
+{
+    pthread_rwlock_t lock;    // Taken for reading by searches and for writing by every other operation
+    Node *buckets;            // Array of linked lists (buckets)
+    size_t size;              // Number of elements in segment
+    size_t capacity;          // Number of buckets, always a power of two
+    size_t threshold;         // Maximum elements segment can hold before resizing
+}
+__attribute__((aligned(CACHE_LINE))) segment;
+
+struct concurrent_hash
+{
+    struct segment *segments;  // Array of segments
+    size_t seg_count;          // Number of segments, always a power of two
+    hashFunc key_hash;
+    cmpFunc key_cmp;
+    destroyFunc key_destroy;
+    destroyFunc val_destroy;
+    int flag;
+};
+
+
+
+////////////////////////////////////// FUNCTIONS FOR HASHES ///////////////////////////////////////
+
+// Return segment that holds hash
+static inline struct segment *hash_segment(ConcurrentHash table, size_t hash)
+{
+    return table->segments + ((hash >> SEGMENT_SHIFT) & (table->seg_count - 1));
+}
+
+// Return bucket of segment that holds hash
+static inline Node *hash_bucket(struct segment *seg, size_t hash)
+{
+    return seg->buckets + (hash & (seg->capacity - 1));
+}
+
+// Set table flag, several threads may set it at once
+static inline void set_flag(ConcurrentHash table, int flag)
+{
+    __atomic_store_n(&table->flag, flag, __ATOMIC_RELAXED);
+}
+
+
+
+////////////////////////////////////// FUNCTIONS FOR SEGMENTS /////////////////////////////////////
+
+// Initialize segment lock and buckets, return true if successful
+static bool segment_init(struct segment *seg)
+{
+    seg->buckets = calloc(MIN_CAPACITY, sizeof(Node));
+    if (!seg->buckets) return false;
+
+    if (pthread_rwlock_init(&seg->lock, NULL))
+    {
+        free(seg->buckets);
+        return false;
+    }
+
+    seg->size = 0;
+    seg->capacity = MIN_CAPACITY;
+    seg->threshold = seg->capacity * LOAD_FACTOR;
+    return true;
+}
+
+// Return node of segment that holds key, or NULL if such node does not exist
+static Node segment_search(ConcurrentHash table, struct segment *seg, void *key, size_t hash)
+{
+    Node node = *hash_bucket(seg, hash);
+
+    while (node && (node->hash != hash || table->key_cmp(key, node->key)))
+        node = node->next;
+
+    return node;
+}
+
+// Double number of buckets of segment, return true if successful
+// Only this segment is locked while its elements are moved
+static bool segment_rehash(struct segment *seg)
+{
+    size_t new_capacity = seg->capacity * 2;
+    Node *new_buckets = calloc(new_capacity, sizeof(Node));
+    if (!new_buckets) return false;
+
+    for (size_t i = 0; i < seg->capacity; i++)
+    {
+        Node node = seg->buckets[i];
+
+        while (node)
+        {
+            Node next_node = node->next;
+            size_t index = node->hash & (new_capacity - 1);
+
+            node->next = new_buckets[index];
+            new_buckets[index] = node;
+            node = next_node;
+        }
+    }
+
+    free(seg->buckets);
+    seg->buckets = new_buckets;
+    seg->capacity = new_capacity;
+    seg->threshold = seg->capacity * LOAD_FACTOR;
+    return true;
+}
+
+// Free memory allocated for every node of segment
+static void segment_destroy_nodes(ConcurrentHash table, struct segment *seg)
+{
+    for (size_t i = 0; i < seg->capacity; i++)
+    {
+        Node node = seg->buckets[i];
+
+        while (node)
+        {
+            Node next_node = node->next;
+
+            if (table->key_destroy) table->key_destroy(node->key);
+            if (table->val_destroy) table->val_destroy(node->value);
+            free(node);
+
+            node = next_node;
+        }
+
+        seg->buckets[i] = NULL;
+    }
+
+    seg->size = 0;
+}
+
+
+///////////////////////////////////////// MAIN FUNCTIONS ///////////////////////////////////////////
+
+
+ConcurrentHash chash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    return chash_init_custom(SEGMENTS, key_hash, key_cmp, key_destroy, val_destroy);
+}
+
+ConcurrentHash chash_init_custom(size_t segments, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    if (!key_hash || !key_cmp || !segments || segments > MAX_SEGMENTS)
+        return NULL;
+
+    ConcurrentHash table = malloc(sizeof(struct concurrent_hash));
+    if (!table) return NULL;
+
+    // Round number of segments up to a power of two
+    table->seg_count = 1;
+    while (table->seg_count < segments)
+        table->seg_count *= 2;
+
+    table->segments = aligned_alloc(CACHE_LINE, table->seg_count * sizeof(struct segment));
+
+    if (!table->segments)
+    {
+        free(table); return NULL;
+    }
+
+    for (size_t i = 0; i < table->seg_count; i++)
+    {
+        if (!segment_init(table->segments + i))
+        {
+            for (size_t j = 0; j < i; j++)
+            {
+                pthread_rwlock_destroy(&table->segments[j].lock);
+                free(table->segments[j].buckets);
+            }
+
+            free(table->segments); free(table);
+            return NULL;
+        }
+    }
+
+    table->key_hash = key_hash;
+    table->key_cmp = key_cmp;
+    table->key_destroy = key_destroy;
+    table->val_destroy = val_destroy;
+    table->flag = OK;
+
+    return table;
+}
+
+bool chash_empty(ConcurrentHash table)
+{
+    return chash_size(table) == 0;
+}
+
+size_t chash_size(ConcurrentHash table)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < table->seg_count; i++)
+    {
+        pthread_rwlock_rdlock(&table->segments[i].lock);
+        size += table->segments[i].size;
+        pthread_rwlock_unlock(&table->segments[i].lock);
+    }
+
+    return size;
+}
+
+bool chash_insert(ConcurrentHash table, void *key, void *value)
+{
+    // Hash key before taking the lock
+    size_t hash = hash_mix64(table->key_hash(key));
+    struct segment *seg = hash_segment(table, hash);
+
+    pthread_rwlock_wrlock(&seg->lock);
+
+    // If key is already in segment, replace key and value
+    Node node = segment_search(table, seg, key, hash);
+
+    if (node)
+    {
+        if (table->key_destroy) table->key_destroy(node->key);
+        if (table->val_destroy) table->val_destroy(node->value);
+
+        node->key = key;
+        node->value = value;
+
+        pthread_rwlock_unlock(&seg->lock);
+        return true;
+    }
+
+    // Resize segment if necessary
+    if (seg->size >= seg->threshold && !segment_rehash(seg))
+    {
+        pthread_rwlock_unlock(&seg->lock);
+        set_flag(table, ALLOC);
+        return false;
+    }
+
+    node = malloc(sizeof(struct node));
+
+    if (!node)
+    {
+        pthread_rwlock_unlock(&seg->lock);
+        set_flag(table, ALLOC);
+        return false;
+    }
+
+    node->key = key;
+    node->value = value;
+    node->hash = hash;
+
+    // Insert node at the start of its bucket
+    Node *bucket = hash_bucket(seg, hash);
+    node->next = *bucket;
+    *bucket = node;
+    seg->size++;
+
+    pthread_rwlock_unlock(&seg->lock);
+    return true;
+}
+
+void *chash_search(ConcurrentHash table, void *key)
+{
+    size_t hash = hash_mix64(table->key_hash(key));
+    struct segment *seg = hash_segment(table, hash);
+
+    pthread_rwlock_rdlock(&seg->lock);
+
+    Node node = segment_search(table, seg, key, hash);
+    void *value = node ? node->value : NULL;
+
+    pthread_rwlock_unlock(&seg->lock);
+    return value;
+}
+
+bool chash_remove(ConcurrentHash table, void *key)
+{
+    size_t hash = hash_mix64(table->key_hash(key));
+    struct segment *seg = hash_segment(table, hash);
+
+    pthread_rwlock_wrlock(&seg->lock);
+
+    // Find pointer to the node that holds key so it can be unlinked
+    Node *link = hash_bucket(seg, hash);
+
+    while (*link && ((*link)->hash != hash || table->key_cmp(key, (*link)->key)))
+        link = &(*link)->next;
+
+    Node node = *link;
+
+    if (node)
+    {
+        *link = node->next;
+        seg->size--;
+    }
+
+    pthread_rwlock_unlock(&seg->lock);
+
+    if (!node) return false;
+
+    // Elements are destroyed outside the lock, no other thread can reach the node now
+    if (table->key_destroy) table->key_destroy(node->key);
+    if (table->val_destroy) table->val_destroy(node->value);
+    free(node);
+
+    return true;
+}
+
+void chash_clear(ConcurrentHash table)
+{
+    // Segments are cleared one at a time, so other segments stay usable
+    for (size_t i = 0; i < table->seg_count; i++)
+    {
+        pthread_rwlock_wrlock(&table->segments[i].lock);
+        segment_destroy_nodes(table, table->segments + i);
+        pthread_rwlock_unlock(&table->segments[i].lock);
+    }
+}
+
+void chash_destroy(ConcurrentHash table)
+{
+    for (size_t i = 0; i < table->seg_count; i++)
+    {
+        segment_destroy_nodes(table, table->segments + i);
+        pthread_rwlock_destroy(&table->segments[i].lock);
+        free(table->segments[i].buckets);
+    }
+
+    free(table->segments);
+    free(table);
+}
+
+int chash_flag(ConcurrentHash table)
+{
+    return __atomic_load_n(&table->flag, __ATOMIC_RELAXED);
+}
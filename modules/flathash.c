@@ -0,0 +1,400 @@
+#include "../include/flathash.h"
+#include "../include/flags.h"
+#include "../include/hashfunc.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16              // Number of control bytes compared at once
+#define MIN_CAPACITY 16             // Initial number of slots, a power of two no smaller than GROUP_WIDTH
+#define NOT_FOUND __SIZE_MAX__
+
+#define CTRL_EMPTY ((int8_t) -128)  // Slot has never held an element
+#define CTRL_DELETED ((int8_t) -2)  // Slot held an element that was removed
+                                    // Full slots hold the 7 lower bits of their hash (0 to 127)
+
+typedef struct slot
+{
+    void *key;            // Key stored in slot
+    void *value;          // Value associated with the key
+    size_t hash;          // Mixed hash of the key
+}
+slot;
+
+struct flathash
+{
+    int8_t *ctrl;         // Control byte of every slot, followed by a copy of the first GROUP_WIDTH bytes
+    struct slot *slots;   // Array of slots
+    size_t size;          // Number of elements in table
+    size_t capacity;      // Number of slots, always a power of two
+    size_t growth_left;   // Number of empty slots that can be filled before resizing
+    hashFunc key_hash;
+    cmpFunc key_cmp;
+    destroyFunc key_destroy;
+    destroyFunc val_destroy;
+    int flag;
+};
+
+
+
+////////////////////////////////////// FUNCTIONS FOR HASHES ///////////////////////////////////////
+
+// Upper bits of hash select the slot where probing starts
+static inline size_t hash_pos(size_t hash)
+{
+    return hash >> 7;
+}
+
+// Lower 7 bits of hash are stored in the control byte
+static inline int8_t hash_tag(size_t hash)
+{
+    return hash & 0x7F;
+}
+
+// Maximum number of elements table can hold before resizing
+static inline size_t max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
+}
+
+
+
+////////////////////////////////////// FUNCTIONS FOR GROUPS ///////////////////////////////////////
+
+// Return bitmask of the GROUP_WIDTH slots starting at ctrl whose control byte is equal to tag
+static inline uint32_t group_match(const int8_t *ctrl, int8_t tag)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+        mask |= (uint32_t) (ctrl[i] == tag) << i;
+    return mask;
+#endif
+}
+
+// Return bitmask of the empty slots in group
+static inline uint32_t group_match_empty(const int8_t *ctrl)
+{
+    return group_match(ctrl, CTRL_EMPTY);
+}
+
+// Return bitmask of the empty or deleted slots in group
+static inline uint32_t group_match_free(const int8_t *ctrl)
+{
+#ifdef __SSE2__
+    // Only empty and deleted control bytes are negative
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+        mask |= (uint32_t) (ctrl[i] < 0) << i;
+    return mask;
+#endif
+}
+
+// Set control byte of slot, and its copy if it is one of the first GROUP_WIDTH slots
+static inline void set_ctrl(FlatHash table, size_t index, int8_t ctrl)
+{
+    table->ctrl[index] = ctrl;
+
+    if (index < GROUP_WIDTH)
+        table->ctrl[table->capacity + index] = ctrl;
+}
+
+
+
+////////////////////////////////////// FUNCTIONS FOR SLOTS ////////////////////////////////////////
+
+// Return index of slot that holds key, or NOT_FOUND if key is not in table
+static size_t slot_search(FlatHash table, void *key, size_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t pos = hash_pos(hash) & mask;
+    int8_t tag = hash_tag(hash);
+
+    // Probe groups with triangular steps, which visits every group once
+    for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH)
+    {
+        // Compare keys only for slots with the same tag
+        uint32_t match = group_match(table->ctrl + pos, tag);
+
+        while (match)
+        {
+            size_t index = (pos + __builtin_ctz(match)) & mask;
+            if (table->slots[index].hash == hash && !table->key_cmp(key, table->slots[index].key))
+                return index;
+
+            match &= match - 1;
+        }
+
+        // An empty slot ends the search, since key would have been placed there
+        if (group_match_empty(table->ctrl + pos))
+            return NOT_FOUND;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+// Return index of first empty or deleted slot in the probe sequence of hash
+static size_t slot_find_free(FlatHash table, size_t hash)
+{
+    size_t mask = table->capacity - 1;
+    size_t pos = hash_pos(hash) & mask;
+
+    for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH)
+    {
+        uint32_t match = group_match_free(table->ctrl + pos);
+
+        if (match)
+            return (pos + __builtin_ctz(match)) & mask;
+
+        pos = (pos + step) & mask;
+    }
+}
+
+// Free memory allocated for key and value of slot
+static inline void slot_destroy(FlatHash table, size_t index)
+{
+    if (table->key_destroy) table->key_destroy(table->slots[index].key);
+    if (table->val_destroy) table->val_destroy(table->slots[index].value);
+}
+
+// Destroy elements of every full slot
+static void slots_destroy(FlatHash table)
+{
+    if (!table->key_destroy && !table->val_destroy)
+        return;
+
+    for (size_t i = 0; i < table->capacity; i++)
+        if (table->ctrl[i] >= 0)
+            slot_destroy(table, i);
+}
+
+// Allocate control bytes and slots for a table of given capacity, return true if successful
+static bool slots_alloc(FlatHash table, size_t capacity)
+{
+    int8_t *ctrl = malloc(capacity + GROUP_WIDTH);
+    struct slot *slots = malloc(capacity * sizeof(struct slot));
+
+    if (!ctrl || !slots)
+    {
+        free(ctrl); free(slots);
+        return false;
+    }
+
+    memset(ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+
+    table->ctrl = ctrl;
+    table->slots = slots;
+    table->capacity = capacity;
+    table->growth_left = max_load(capacity) - table->size;
+    return true;
+}
+
+
+
+////////////////////////////////////// FUNCTIONS FOR RESIZING /////////////////////////////////////
+
+// Move elements of table to table of new capacity, return true if successful
+static bool rehash(FlatHash table, size_t new_capacity)
+{
+    // Save old arrays and allocate new ones
+    int8_t *old_ctrl = table->ctrl;
+    struct slot *old_slots = table->slots;
+    size_t old_capacity = table->capacity;
+
+    if (!slots_alloc(table, new_capacity))
+        return false;
+
+    // Insert every element to its new slot, no keys need to be compared
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old_ctrl[i] < 0) continue;
+
+        size_t index = slot_find_free(table, old_slots[i].hash);
+        set_ctrl(table, index, hash_tag(old_slots[i].hash));
+        table->slots[index] = old_slots[i];
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+    return true;
+}
+
+// Make room for a new element, return false only if resizing was unsuccessful
+static bool flathash_resize(FlatHash table)
+{
+    if (table->growth_left)
+        return true;
+
+    // If most used slots are deleted, clean them up without growing
+    if (table->size <= max_load(table->capacity) / 2)
+        return rehash(table, table->capacity);
+
+    return rehash(table, table->capacity * 2);
+}
+
+
+///////////////////////////////////////// MAIN FUNCTIONS ///////////////////////////////////////////
+
+
+FlatHash flathash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    if (!key_hash || !key_cmp)
+        return NULL;
+
+    FlatHash table = malloc(sizeof(struct flathash));
+    if (!table) return NULL;
+
+    table->size = 0;
+
+    if (!slots_alloc(table, MIN_CAPACITY))
+    {
+        free(table); return NULL;
+    }
+
+    table->key_hash = key_hash;
+    table->key_cmp = key_cmp;
+    table->key_destroy = key_destroy;
+    table->val_destroy = val_destroy;
+    table->flag = OK;
+
+    return table;
+}
+
+bool flathash_empty(FlatHash table)
+{
+    return (table->size == 0);
+}
+
+size_t flathash_size(FlatHash table)
+{
+    return table->size;
+}
+
+size_t flathash_capacity(FlatHash table)
+{
+    return table->capacity;
+}
+
+bool flathash_insert(FlatHash table, void *key, void *value)
+{
+    size_t hash = hash_mix64(table->key_hash(key));
+    size_t index = slot_search(table, key, hash);
+
+    // If key is already in table, replace key and value
+    if (index != NOT_FOUND)
+    {
+        slot_destroy(table, index);
+        table->slots[index].key = key;
+        table->slots[index].value = value;
+        return true;
+    }
+
+    // Resize table if necessary
+    if (!flathash_resize(table))
+    {
+        table->flag = ALLOC;
+        return false;
+    }
+
+    // Place element in first free slot, deleted slots can be reused without using up growth
+    index = slot_find_free(table, hash);
+    if (table->ctrl[index] == CTRL_EMPTY) table->growth_left--;
+
+    set_ctrl(table, index, hash_tag(hash));
+    table->slots[index].key = key;
+    table->slots[index].value = value;
+    table->slots[index].hash = hash;
+    table->size++;
+
+    return true;
+}
+
+void *flathash_search(FlatHash table, void *key)
+{
+    size_t index = slot_search(table, key, hash_mix64(table->key_hash(key)));
+
+    if (index == NOT_FOUND) return NULL;
+    return table->slots[index].value;
+}
+
+bool flathash_remove(FlatHash table, void *key)
+{
+    size_t index = slot_search(table, key, hash_mix64(table->key_hash(key)));
+    if (index == NOT_FOUND) return false;
+
+    slot_destroy(table, index);
+    table->size--;
+
+    // If every window of GROUP_WIDTH slots around this one has an empty slot, no search
+    // could have probed past it, so it can be marked empty instead of deleted
+    size_t mask = table->capacity - 1;
+    uint32_t empty_before = group_match_empty(table->ctrl + ((index - GROUP_WIDTH) & mask));
+    uint32_t empty_after = group_match_empty(table->ctrl + index);
+
+    if (empty_before && empty_after && __builtin_ctz(empty_after) + __builtin_clz(empty_before) - 16 < GROUP_WIDTH)
+    {
+        set_ctrl(table, index, CTRL_EMPTY);
+        table->growth_left++;
+    }
+    else set_ctrl(table, index, CTRL_DELETED);
+
+    return true;
+}
+
+bool flathash_clear(FlatHash table)
+{
+    slots_destroy(table);
+
+    memset(table->ctrl, CTRL_EMPTY, table->capacity + GROUP_WIDTH);
+    table->size = 0;
+    table->growth_left = max_load(table->capacity);
+
+    if (table->capacity == MIN_CAPACITY)
+        return true;
+
+    // Shrink table back to its initial capacity, old arrays are still valid if this fails
+    int8_t *old_ctrl = table->ctrl;
+    struct slot *old_slots = table->slots;
+
+    if (!slots_alloc(table, MIN_CAPACITY))
+    {
+        table->flag = ALLOC;
+        return false;
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+    return true;
+}
+
+void flathash_destroy(FlatHash table)
+{
+    slots_destroy(table);
+
+    free(table->ctrl);
+    free(table->slots);
+    free(table);
+}
+
+void flathash_set_key_destroy(FlatHash table, destroyFunc key_destroy)
+{
+    table->key_destroy = key_destroy;
+}
+
+void flathash_set_val_destroy(FlatHash table, destroyFunc val_destroy)
+{
+    table->val_destroy = val_destroy;
+}
+
+int flathash_flag(FlatHash table)
+{
+    return table->flag;
+}
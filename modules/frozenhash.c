@@ -0,0 +1,385 @@
+#include "../include/frozenhash.h"
+#include "../include/flags.h"
+#include "../include/hashfunc.h"
+#include <stdint.h>
+#include <string.h>
+
+#define BUCKET_KEYS 4                    // Average number of keys per bucket
+#define MAX_ATTEMPTS 8                   // Number of seeds tried before building fails
+#define PILOT_TRIES 1024                 // Displacement values tried per bucket on average before a new seed is tried
+#define EXTRA_SLOTS 100                      // Keys are placed among n + n / EXTRA_SLOTS positions
+#define DENSE_HASHES 0x9999999999999999ULL  // 60% of hashes go to the dense buckets
+#define DENSE_BUCKETS 0.3                    // Fraction of buckets that are dense
+#define PILOT_MUL 0x9e3779b97f4a7c15ULL  // Spreads bits of displacement values over the whole hash
+
+typedef struct slot
+{
+    void *key;            // Key stored in slot
+    void *value;          // Value associated with the key
+}
+slot;
+
+struct frozen_hash
+{
+    struct slot *slots;   // One slot for every key
+    uint32_t *pilots;     // Displacement value of every bucket
+    size_t *remap;        // Slot of every key placed at a position past the last slot
+    size_t size;          // Number of elements in table, which is also the number of slots
+    size_t range;         // Number of positions keys are placed among, a few more than the slots
+    size_t buckets;       // Number of buckets keys are split into
+    size_t dense;         // Number of buckets that get most of the keys
+    size_t seed;          // Seed mixed into every hash, chosen so that a displacement is found for every bucket
+    hashFunc key_hash;
+    cmpFunc key_cmp;
+    destroyFunc key_destroy;
+    destroyFunc val_destroy;
+    int flag;
+};
+
+// Arrays used while the table is built
+typedef struct build
+{
+    size_t *hashes;       // Hash of every key
+    size_t *order;        // Indices of keys sorted by bucket
+    size_t *start;        // Index in order where the keys of every bucket start, followed by n
+    size_t *by_size;      // Buckets sorted from largest to smallest
+    uint64_t *taken;      // Bitmap of positions that have been given to a key
+    size_t *positions;    // Slots of the keys of the bucket being placed
+}
+build;
+
+// Result of placing the keys with one seed
+typedef enum place_result {PLACED, RETRY, DUPLICATE} PlaceResult;
+
+
+
+////////////////////////////////////// FUNCTIONS FOR HASHES ///////////////////////////////////////
+
+// Map hash to a number from 0 to n - 1 using its upper bits, without a division
+static inline size_t fast_range(size_t hash, size_t n)
+{
+    return ((__uint128_t) hash * n) >> 64;
+}
+
+// Return bucket of hash
+// Most keys go to a few dense buckets, so that these are placed first and the
+// remaining buckets are small enough to fit in the last free slots
+static inline size_t hash_bucket(FrozenHash table, size_t hash)
+{
+    size_t bits = hash * PILOT_MUL;
+
+    if (hash < DENSE_HASHES)
+        return fast_range(bits, table->dense);
+
+    return table->dense + fast_range(bits, table->buckets - table->dense);
+}
+
+// Return hash of key mixed with the seed of the table
+static inline size_t key_hash(FrozenHash table, void *key)
+{
+    return hash_mix64(table->key_hash(key) ^ table->seed);
+}
+
+// Return position of key with given hash among n positions, when its bucket has given displacement value
+static inline size_t slot_index(size_t hash, uint32_t pilot, size_t n)
+{
+    return fast_range(hash_mix64(hash ^ (pilot * PILOT_MUL)), n);
+}
+
+// Return slot of key with given hash
+// Positions past the last slot are sent to the slots that no key was placed at, or to the first
+// slot if no key was placed there, since they can only be reached by keys that are not in the table
+static inline size_t hash_slot(FrozenHash table, size_t hash)
+{
+    size_t pos = slot_index(hash, table->pilots[hash_bucket(table, hash)], table->range);
+    return pos < table->size ? pos : table->remap[pos - table->size];
+}
+
+
+
+///////////////////////////////////// FUNCTIONS FOR BUILDING //////////////////////////////////////
+
+// Allocate arrays used to build a table of n keys placed among range positions, return true if successful
+static bool build_init(build *b, size_t n, size_t range, size_t buckets)
+{
+    b->hashes = malloc(n * sizeof(size_t));
+    b->order = malloc(n * sizeof(size_t));
+    b->start = malloc((buckets + 1) * sizeof(size_t));
+    b->by_size = malloc(buckets * sizeof(size_t));
+    b->taken = malloc((range + 63) / 64 * sizeof(uint64_t));
+    b->positions = malloc((n + 1) * sizeof(size_t));
+
+    return b->hashes && b->order && b->start && b->by_size && b->taken && b->positions;
+}
+
+// Free arrays used to build the table
+static void build_destroy(build *b)
+{
+    free(b->hashes);
+    free(b->order);
+    free(b->start);
+    free(b->by_size);
+    free(b->taken);
+    free(b->positions);
+}
+
+// Sort keys by bucket and buckets by number of keys
+static void sort_buckets(FrozenHash table, build *b)
+{
+    size_t n = table->size, buckets = table->buckets;
+
+    // Count keys of every bucket, then turn counts into the index where each bucket ends
+    memset(b->start, 0, (buckets + 1) * sizeof(size_t));
+
+    for (size_t i = 0; i < n; i++)
+        b->start[hash_bucket(table, b->hashes[i])]++;
+
+    size_t max_size = 0;
+
+    for (size_t i = 0, sum = 0; i < buckets; i++)
+    {
+        if (b->start[i] > max_size) max_size = b->start[i];
+
+        sum += b->start[i];
+        b->start[i] = sum;
+    }
+
+    b->start[buckets] = n;
+
+    // Keys are placed from the end of each bucket, which leaves start at the first key of the bucket
+    for (size_t i = n; i-- > 0; )
+        b->order[--b->start[hash_bucket(table, b->hashes[i])]] = i;
+
+    // Buckets are sorted by size with a counting sort, the counts go in positions since it's not used yet
+    size_t *count = b->positions;
+    memset(count, 0, (max_size + 1) * sizeof(size_t));
+
+    for (size_t i = 0; i < buckets; i++)
+        count[b->start[i + 1] - b->start[i]]++;
+
+    for (size_t size = max_size + 1, sum = 0; size-- > 0; )
+    {
+        size_t c = count[size];
+        count[size] = sum;
+        sum += c;
+    }
+
+    for (size_t i = 0; i < buckets; i++)
+        b->by_size[count[b->start[i + 1] - b->start[i]]++] = i;
+}
+
+// Return true if position has been given to a key
+static inline bool slot_taken(build *b, size_t pos)
+{
+    return b->taken[pos / 64] >> (pos % 64) & 1;
+}
+
+// Find a displacement value for bucket that sends its keys to untaken positions and take these positions
+// Every value tried is taken from tries, and the search gives up once none are left
+static PlaceResult place_bucket(FrozenHash table, build *b, size_t bucket, size_t *tries)
+{
+    size_t *first = b->order + b->start[bucket];
+    size_t size = b->start[bucket + 1] - b->start[bucket];
+
+    // Keys with the same hash always land in the same slot
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = i + 1; j < size; j++)
+        {
+            if (b->hashes[first[i]] == b->hashes[first[j]])
+                return DUPLICATE;
+        }
+    }
+
+    for (uint64_t pilot = 0; pilot <= UINT32_MAX && *tries; pilot++, (*tries)--)
+    {
+        size_t placed = 0;
+
+        while (placed < size)
+        {
+            size_t pos = slot_index(b->hashes[first[placed]], pilot, table->range);
+            if (slot_taken(b, pos)) break;
+
+            // Keys of the same bucket must not land in the same position either
+            size_t i = 0;
+            while (i < placed && b->positions[i] != pos) i++;
+            if (i < placed) break;
+
+            b->positions[placed++] = pos;
+        }
+
+        if (placed == size)
+        {
+            for (size_t i = 0; i < size; i++)
+                b->taken[b->positions[i] / 64] |= (uint64_t) 1 << (b->positions[i] % 64);
+
+            table->pilots[bucket] = pilot;
+            return PLACED;
+        }
+    }
+
+    return RETRY;
+}
+
+// Give every key a slot with the current seed
+static PlaceResult place_keys(FrozenHash table, build *b, void **keys)
+{
+    for (size_t i = 0; i < table->size; i++)
+        b->hashes[i] = key_hash(table, keys[i]);
+
+    sort_buckets(table, b);
+    memset(b->taken, 0, (table->range + 63) / 64 * sizeof(uint64_t));
+
+    // About 90 values are tried per bucket on average, so running out means the seed is unlucky
+    size_t tries = table->buckets * PILOT_TRIES;
+
+    // Largest buckets are placed first, while most slots are still free
+    for (size_t i = 0; i < table->buckets; i++)
+    {
+        size_t bucket = b->by_size[i];
+        if (b->start[bucket] == b->start[bucket + 1]) break;
+
+        PlaceResult result = place_bucket(table, b, bucket, &tries);
+        if (result != PLACED) return result;
+    }
+
+    return PLACED;
+}
+
+// Send every taken position past the last slot to a slot no key was placed at
+static void remap_positions(FrozenHash table, build *b)
+{
+    size_t free_slot = 0;
+
+    for (size_t pos = table->size; pos < table->range; pos++)
+    {
+        if (!slot_taken(b, pos)) continue;
+
+        // There are as many free slots as taken positions past the last slot
+        while (slot_taken(b, free_slot)) free_slot++;
+        table->remap[pos - table->size] = free_slot++;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+FrozenHash frozen_init(void **keys, void **values, size_t n, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    if (!key_hash || !key_cmp || (n && !keys))
+        return NULL;
+
+    FrozenHash table = malloc(sizeof(struct frozen_hash));
+    if (!table) return NULL;
+
+    table->size = n;
+    table->buckets = n ? (n + BUCKET_KEYS - 1) / BUCKET_KEYS : 0;
+    table->dense = table->buckets * DENSE_BUCKETS;
+    table->range = n + n / EXTRA_SLOTS;
+    table->key_hash = key_hash;
+    table->key_cmp = key_cmp;
+    table->key_destroy = key_destroy;
+    table->val_destroy = val_destroy;
+    table->flag = OK;
+
+    table->slots = NULL;
+    table->pilots = NULL;
+    table->remap = NULL;
+
+    if (!n) return table;
+
+    table->slots = malloc(n * sizeof(struct slot));
+    table->pilots = calloc(table->buckets, sizeof(uint32_t));
+    table->remap = calloc(table->range - n + 1, sizeof(size_t));
+
+    build b;
+    bool allocated = build_init(&b, n, table->range, table->buckets);
+
+    if (!table->slots || !table->pilots || !table->remap || !allocated)
+    {
+        build_destroy(&b);
+
+        table->size = 0;
+        frozen_destroy(table);
+        return NULL;
+    }
+
+    // A new seed gives every key a new hash, in the unlikely case that some bucket can't be placed
+    size_t seed = hash_random_seed();
+    PlaceResult result = RETRY;
+
+    for (int attempt = 0; attempt < MAX_ATTEMPTS && result == RETRY; attempt++)
+    {
+        table->seed = hash_mix64(seed + attempt);
+        result = place_keys(table, &b, keys);
+    }
+
+    if (result != PLACED)
+    {
+        build_destroy(&b);
+
+        // Keys are not owned by the table yet
+        table->size = 0;
+        frozen_destroy(table);
+        return NULL;
+    }
+
+    remap_positions(table, &b);
+
+    // Move every pair to its slot
+    for (size_t i = 0; i < n; i++)
+    {
+        struct slot *slot = table->slots + hash_slot(table, b.hashes[i]);
+
+        slot->key = keys[i];
+        slot->value = values ? values[i] : NULL;
+    }
+
+    build_destroy(&b);
+    return table;
+}
+
+bool frozen_empty(FrozenHash table)
+{
+    return (table->size == 0);
+}
+
+size_t frozen_size(FrozenHash table)
+{
+    return table->size;
+}
+
+void *frozen_search(FrozenHash table, void *key)
+{
+    if (!table->size) return NULL;
+
+    // Only one slot can hold key
+    struct slot *slot = table->slots + hash_slot(table, key_hash(table, key));
+
+    return table->key_cmp(key, slot->key) ? NULL : slot->value;
+}
+
+void frozen_foreach(FrozenHash table, frozenForeachFunc fn, void *ctx)
+{
+    for (size_t i = 0; i < table->size; i++)
+        fn(table->slots[i].key, table->slots[i].value, ctx);
+}
+
+void frozen_destroy(FrozenHash table)
+{
+    for (size_t i = 0; i < table->size; i++)
+    {
+        if (table->key_destroy) table->key_destroy(table->slots[i].key);
+        if (table->val_destroy) table->val_destroy(table->slots[i].value);
+    }
+
+    free(table->slots);
+    free(table->pilots);
+    free(table->remap);
+    free(table);
+}
+
+int frozen_flag(FrozenHash table)
+{
+    return table->flag;
+}
@@ -0,0 +1,195 @@
+#include "../include/hashfunc.h"
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+
+// Constants of wyhash
+#define WY0 0xa0761d6478bd642fULL
+#define WY1 0xe7037ed1a0b428dbULL
+#define WY2 0x8ebc6af09c88c6e3ULL
+#define WY3 0x589965cc75374cc3ULL
+
+
+///////////////////////////////////////// HELPER FUNCTIONS //////////////////////////////////////////
+
+// Multiply two 64-bit integers and fold the 128-bit product into 64 bits
+static inline uint64_t wy_mix(uint64_t a, uint64_t b)
+{
+    __uint128_t product = (__uint128_t) a * b;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+// Read 8 bytes from p, p doesn't need to be aligned
+static inline uint64_t read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// Read 4 bytes from p
+static inline uint64_t read4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// Read 1 to 3 bytes from p so that every byte is used
+static inline uint64_t read3(const uint8_t *p, size_t len)
+{
+    return ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+}
+
+// Hash len bytes starting at data, inlined so that calls with a constant len are specialized
+static inline uint64_t wyhash(const void *data, size_t len, uint64_t seed)
+{
+    const uint8_t *p = data;
+    uint64_t a, b;
+
+    seed ^= wy_mix(seed ^ WY0, WY1);
+
+    // Short inputs are read with up to four overlapping loads
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+            b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0)
+        {
+            a = read3(p, len);
+            b = 0;
+        }
+        else a = b = 0;
+    }
+    else
+    {
+        size_t i = len;
+
+        // Long inputs are mixed in three independent lanes of 16 bytes
+        if (i > 48)
+        {
+            uint64_t seed1 = seed, seed2 = seed;
+
+            do
+            {
+                seed = wy_mix(read8(p) ^ WY1, read8(p + 8) ^ seed);
+                seed1 = wy_mix(read8(p + 16) ^ WY2, read8(p + 24) ^ seed1);
+                seed2 = wy_mix(read8(p + 32) ^ WY3, read8(p + 40) ^ seed2);
+                p += 48; i -= 48;
+            }
+            while (i > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16)
+        {
+            seed = wy_mix(read8(p) ^ WY1, read8(p + 8) ^ seed);
+            p += 16; i -= 16;
+        }
+
+        // Last 16 bytes, which may overlap bytes already mixed
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= WY1;
+    b ^= seed;
+
+    __uint128_t product = (__uint128_t) a * b;
+    a = (uint64_t) product;
+    b = (uint64_t) (product >> 64);
+
+    return wy_mix(a ^ WY0 ^ len, b ^ WY1);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+size_t hash_bytes(const void *data, size_t len, size_t seed)
+{
+    return wyhash(data, len, seed);
+}
+
+size_t hash_str(const void *str)
+{
+    return wyhash(str, strlen(str), 0);
+}
+
+size_t hash_random_seed(void)
+{
+    size_t seed;
+
+#ifdef __linux__
+    // Doesn't block, fails only if the generator hasn't been initialized yet at boot
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == sizeof(seed))
+        return seed;
+#endif
+
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+    if (fd >= 0)
+    {
+        ssize_t got = read(fd, &seed, sizeof(seed));
+        close(fd);
+
+        if (got == sizeof(seed))
+            return seed;
+    }
+
+    // Stack address depends on address space randomization, time and counter make seeds of calls close together differ
+    static size_t counter;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    seed = hash_mix64((uintptr_t) &seed ^ (uint64_t) ts.tv_nsec ^ ((uint64_t) getpid() << 32));
+    return hash_mix64(seed ^ (uint64_t) ts.tv_sec ^ __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED));
+}
+
+size_t hash_int(const void *num)
+{
+    return hash_mix64((uint64_t) (unsigned int) *(const int *) num);
+}
+
+size_t hash_u32(const void *num)
+{
+    return hash_mix64(*(const uint32_t *) num);
+}
+
+size_t hash_u64(const void *num)
+{
+    return hash_mix64(*(const uint64_t *) num);
+}
+
+size_t hash_ptr(const void *ptr)
+{
+    return hash_mix64((uintptr_t) ptr);
+}
+
+size_t hash_mem8(const void *data)
+{
+    return wyhash(data, 8, 0);
+}
+
+size_t hash_mem16(const void *data)
+{
+    return wyhash(data, 16, 0);
+}
+
+size_t hash_mem32(const void *data)
+{
+    return wyhash(data, 32, 0);
+}
+
+size_t hash_mem64(const void *data)
+{
+    return wyhash(data, 64, 0);
+}
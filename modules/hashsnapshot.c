@@ -0,0 +1,359 @@
+#include "../include/hashsnapshot.h"
+#include "../include/hashfunc.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "GDSHSNAP"
+#define VERSION 1
+#define BYTE_ORDER_MARK 0x01020304  // Read back differently on machines of the other byte order
+#define TMP_SUFFIX ".XXXXXX"        // Replaced by mkstemp to name the file while it is written
+
+// Header at the start of the file
+typedef struct header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;       // Number of entries
+    uint64_t buckets;     // Number of buckets, always a power of two
+    uint64_t seed;        // Seed given to hash_bytes
+    uint64_t file_size;   // Size of the whole file
+}
+header;
+
+// Header of every entry, followed by the key and value, each padded to 8 bytes
+typedef struct entry
+{
+    uint64_t hash;        // Hash of the encoded key
+    uint32_t key_len;     // Length of the encoded key
+    uint32_t val_len;     // Length of the encoded value
+}
+entry;
+
+// Offsets of the buckets follow the header, bucket i holds the entries from offset i to offset i + 1
+#define OFFSETS_START sizeof(struct header)
+
+struct hash_snapshot
+{
+    const char *base;          // Start of the mapping
+    size_t file_size;          // Size of the mapping
+    const uint64_t *offsets;   // Offset of every bucket from the start of the file, followed by the end of the last one
+    size_t count;              // Number of entries
+    size_t mask;               // Number of buckets minus one
+    size_t seed;
+};
+
+// State shared by the passes over the table while it's saved
+typedef struct save_ctx
+{
+    encodeFunc key_encode;
+    encodeFunc val_encode;
+    uint64_t *cursors;         // Size of every bucket in the first pass, then where its next entry is written
+    char *base;                // Start of the mapping of the file, NULL during the first pass
+    size_t mask;
+    size_t seed;
+    char *key_buf;             // Buffer keys are encoded into to be hashed
+    size_t key_cap;
+    bool failed;
+}
+save_ctx;
+
+
+
+//////////////////////////////////////// HELPER FUNCTIONS //////////////////////////////////////////
+
+// Round len up to a multiple of 8
+static inline size_t pad8(size_t len)
+{
+    return (len + 7) & ~(size_t) 7;
+}
+
+// Return size of an entry with given key and value lengths
+static inline size_t entry_size(size_t key_len, size_t val_len)
+{
+    return sizeof(struct entry) + pad8(key_len) + pad8(val_len);
+}
+
+// Return smallest power of two that is at least n
+static size_t pow2_at_least(size_t n)
+{
+    size_t pow2 = 1;
+
+    while (pow2 < n)
+        pow2 *= 2;
+
+    return pow2;
+}
+
+// Encode key into the buffer of ctx, growing it if necessary, and return its length
+// Set failed in ctx in case of failure
+static size_t encode_key(save_ctx *ctx, void *key)
+{
+    size_t len = ctx->key_encode(key, ctx->key_buf, ctx->key_cap);
+
+    if (len > ctx->key_cap)
+    {
+        char *buf = realloc(ctx->key_buf, len);
+
+        if (!buf)
+        {
+            ctx->failed = true;
+            return 0;
+        }
+
+        ctx->key_buf = buf;
+        ctx->key_cap = len;
+        ctx->key_encode(key, ctx->key_buf, ctx->key_cap);
+    }
+
+    return len;
+}
+
+// First pass, add the size of the entry of the pair to the size of its bucket
+static void count_pair(void *key, void *value, void *context)
+{
+    save_ctx *ctx = context;
+    if (ctx->failed) return;
+
+    size_t key_len = encode_key(ctx, key);
+    size_t val_len = ctx->val_encode(value, NULL, 0);
+
+    if (ctx->failed || key_len > UINT32_MAX || val_len > UINT32_MAX)
+    {
+        ctx->failed = true;
+        return;
+    }
+
+    size_t hash = hash_bytes(ctx->key_buf, key_len, ctx->seed);
+    ctx->cursors[hash & ctx->mask] += entry_size(key_len, val_len);
+}
+
+// Second pass, write the entry of the pair at the next free place of its bucket
+static void write_pair(void *key, void *value, void *context)
+{
+    save_ctx *ctx = context;
+    if (ctx->failed) return;
+
+    // Bucket is not known until the key is hashed, so the key is encoded into the buffer first
+    size_t key_len = encode_key(ctx, key);
+    size_t val_len = ctx->val_encode(value, NULL, 0);
+    if (ctx->failed) return;
+
+    size_t hash = hash_bytes(ctx->key_buf, key_len, ctx->seed);
+    size_t bucket = hash & ctx->mask;
+    const uint64_t *offsets = (const uint64_t *) (ctx->base + OFFSETS_START);
+
+    // Entry must fit in the space counted for it, in case an encoding changed between passes
+    if (ctx->cursors[bucket] + entry_size(key_len, val_len) > offsets[bucket + 1])
+    {
+        ctx->failed = true;
+        return;
+    }
+
+    char *pos = ctx->base + ctx->cursors[bucket];
+    ctx->cursors[bucket] += entry_size(key_len, val_len);
+
+    struct entry *e = (struct entry *) pos;
+    e->hash = hash;
+    e->key_len = key_len;
+    e->val_len = val_len;
+
+    if (key_len) memcpy(pos + sizeof(struct entry), ctx->key_buf, key_len);
+
+    if (ctx->val_encode(value, pos + sizeof(struct entry) + pad8(key_len), val_len) != val_len)
+        ctx->failed = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool hash_save(Hashtable table, const char *path, encodeFunc key_encode, encodeFunc val_encode)
+{
+    if (!path || !key_encode || !val_encode)
+        return false;
+
+    size_t count = hash_size(table);
+    size_t buckets = pow2_at_least(count);
+
+    save_ctx ctx = {.key_encode = key_encode, .val_encode = val_encode, .mask = buckets - 1, .seed = hash_random_seed()};
+    ctx.cursors = calloc(buckets + 1, sizeof(uint64_t));
+    if (!ctx.cursors) return false;
+
+    // First pass finds the size of every bucket
+    hash_foreach(table, count_pair, &ctx);
+
+    if (ctx.failed)
+    {
+        free(ctx.key_buf); free(ctx.cursors);
+        return false;
+    }
+
+    // Turn sizes into offsets, entries start right after the offsets
+    uint64_t offset = OFFSETS_START + (buckets + 1) * sizeof(uint64_t);
+
+    for (size_t i = 0; i <= buckets; i++)
+    {
+        uint64_t size = ctx.cursors[i];
+        ctx.cursors[i] = offset;
+        offset += size;
+    }
+
+    size_t file_size = offset;
+
+    // File is written under a temporary name in the same directory and renamed over path once complete,
+    // so processes that have the old file mapped keep reading it unchanged
+    size_t path_len = strlen(path);
+    char *tmp_path = malloc(path_len + sizeof(TMP_SUFFIX));
+
+    int fd = -1;
+
+    if (tmp_path)
+    {
+        memcpy(tmp_path, path, path_len);
+        memcpy(tmp_path + path_len, TMP_SUFFIX, sizeof(TMP_SUFFIX));
+        fd = mkstemp(tmp_path);
+    }
+
+    if (fd < 0)
+    {
+        free(tmp_path);
+        free(ctx.key_buf); free(ctx.cursors);
+        return false;
+    }
+
+    // Blocks are allocated up front, so a full disk fails here and not as a signal while the mapping is written
+    // File is filled through a shared mapping, so entries can be written in any order
+    char *base = MAP_FAILED;
+    if (!fchmod(fd, 0644) && !posix_fallocate(fd, 0, file_size))
+        base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED)
+    {
+        close(fd); unlink(tmp_path); free(tmp_path);
+        free(ctx.key_buf); free(ctx.cursors);
+        return false;
+    }
+
+    struct header *head = (struct header *) base;
+    memcpy(head->magic, MAGIC, sizeof(head->magic));
+    head->version = VERSION;
+    head->byte_order = BYTE_ORDER_MARK;
+    head->count = count;
+    head->buckets = buckets;
+    head->seed = ctx.seed;
+    head->file_size = file_size;
+
+    memcpy(base + OFFSETS_START, ctx.cursors, (buckets + 1) * sizeof(uint64_t));
+
+    // Second pass writes every entry in its bucket
+    ctx.base = base;
+    hash_foreach(table, write_pair, &ctx);
+
+    bool saved = !ctx.failed && !msync(base, file_size, MS_SYNC) && !fsync(fd);
+
+    munmap(base, file_size);
+    saved = !close(fd) && saved && !rename(tmp_path, path);
+
+    if (!saved) unlink(tmp_path);
+
+    free(tmp_path);
+    free(ctx.key_buf);
+    free(ctx.cursors);
+    return saved;
+}
+
+HashSnapshot snapshot_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || (size_t) st.st_size < sizeof(struct header))
+    {
+        close(fd); return NULL;
+    }
+
+    size_t file_size = st.st_size;
+    const char *base = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // Mapping stays valid after the file is closed
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    const struct header *head = (const struct header *) base;
+
+    bool valid = !memcmp(head->magic, MAGIC, sizeof(head->magic)) && head->version == VERSION &&
+        head->byte_order == BYTE_ORDER_MARK && head->file_size == file_size && head->buckets &&
+        !(head->buckets & (head->buckets - 1)) && head->buckets < file_size / sizeof(uint64_t) &&
+        OFFSETS_START + (head->buckets + 1) * sizeof(uint64_t) <= file_size;
+
+    HashSnapshot snap = valid ? malloc(sizeof(struct hash_snapshot)) : NULL;
+
+    if (!snap)
+    {
+        munmap((void *) base, file_size);
+        return NULL;
+    }
+
+    // Pages are loaded by searches, which touch them in no particular order
+    madvise((void *) base, file_size, MADV_RANDOM);
+
+    snap->base = base;
+    snap->file_size = file_size;
+    snap->offsets = (const uint64_t *) (base + OFFSETS_START);
+    snap->count = head->count;
+    snap->mask = head->buckets - 1;
+    snap->seed = head->seed;
+
+    return snap;
+}
+
+size_t snapshot_size(HashSnapshot snap)
+{
+    return snap->count;
+}
+
+const void *snapshot_search(HashSnapshot snap, const void *key, size_t key_len, size_t *val_len)
+{
+    size_t hash = hash_bytes(key, key_len, snap->seed);
+    size_t bucket = hash & snap->mask;
+
+    uint64_t pos = snap->offsets[bucket], end = snap->offsets[bucket + 1];
+
+    // Offsets are checked here instead of when the file is opened, so that opening doesn't read every page
+    if (end > snap->file_size || pos > end)
+        return NULL;
+
+    while (end - pos >= sizeof(struct entry))
+    {
+        const struct entry *e = (const struct entry *) (snap->base + pos);
+        size_t size = entry_size(e->key_len, e->val_len);
+
+        if (size > end - pos)
+            return NULL;
+
+        const char *data = snap->base + pos + sizeof(struct entry);
+
+        if (e->hash == hash && e->key_len == key_len && !memcmp(data, key, key_len))
+        {
+            if (val_len) *val_len = e->val_len;
+            return data + pad8(key_len);
+        }
+
+        pos += size;
+    }
+
+    return NULL;
+}
+
+void snapshot_close(HashSnapshot snap)
+{
+    munmap((void *) snap->base, snap->file_size);
+    free(snap);
+}
@@ -1,20 +1,74 @@
 #include "../include/hashtable.h"
+#include "../include/hashset.h"
+#include "../include/hashfunc.h"
+#include "../include/redblacktree.h"
+#include "../include/threadpool.h"
 #include "../include/flags.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 #define MAX_PRIME 2200178621
 #define LOAD_FACTOR 0.75
+#define POW2_MIN_CAPACITY 64
+#define SHRINK_RATIO 4     // Table shrinks when it holds fewer than threshold / SHRINK_RATIO elements
+#define REHASH_STEP 16     // Number of buckets moved per operation during incremental rehashing
+#define BATCH_SIZE 32      // Number of keys whose memory accesses are overlapped in batched searches
+#define PREFETCH_DISTANCE 8  // Number of buckets ahead whose first node is prefetched during traversal
+#define TREEIFY_THRESHOLD 8   // Bucket gets a tree once its chain grows past this length
+#define UNTREEIFY_THRESHOLD 6 // Tree of bucket is destroyed once its chain shrinks below this length
+#define PARALLEL_REHASH_MIN 65536  // Tables with fewer elements are always rehashed by one thread
+#define TASKS_PER_THREAD 8          // Buckets are split into more tasks than threads so that threads finish together
+#define SLAB_MIN_NODES 64  // Number of nodes in first slab of node pool
+#define SLAB_MAX_NODES 4096
 
 typedef struct node *Node;
 
+// Value is the last field so that nodes of sets can be allocated without it
 typedef struct node
 {
     void *key;            // Key stored in node
-    void *value;          // Value associated with the key
-    size_t hash;          // Hash value returned by the hash function
+    size_t hash;          // Hash value returned by the hash function, mixed with the seed of the table
     Node next;            // Pointer to next node in list
+    void *value;          // Value associated with the key, not allocated for nodes of sets
 }
 node;
 
+#define SET_NODE_SIZE offsetof(struct node, value)
+
+// Counters updated by searches, insertions and rehashing, left out if HASH_NO_STATS is defined
+typedef struct hash_counters
+{
+    size_t hits;           // Number of searches that found their key
+    size_t hit_probes;     // Number of nodes visited by these searches
+    size_t misses;         // Number of searches that didn't find their key
+    size_t miss_probes;    // Number of nodes visited by these searches
+    size_t rehashes;       // Number of times table was rehashed
+    uint64_t rehash_ns;    // Time spent rehashing, in nanoseconds
+}
+hash_counters;
+
+typedef struct slab *Slab;
+
+struct slab
+{
+    Slab next;            // Previously allocated slab
+    char nodes[];         // Nodes handed out by the pool, node_size bytes each
+};
+
+// Nodes are allocated from large slabs and recycled through a free list, so
+// that inserting and removing elements rarely calls malloc or free
+typedef struct node_pool
+{
+    Slab slabs;           // List of allocated slabs, newest first
+    Node free_nodes;      // Nodes returned to the pool, linked through next
+    size_t slab_used;     // Number of nodes handed out from newest slab
+    size_t slab_nodes;    // Number of nodes in newest slab
+    size_t node_size;     // Size of each node, smaller for sets since they have no values
+}
+node_pool;
+
 struct hashtable
 {
     Node *buckets;         // Array of linked lists (buckets)
@@ -22,14 +76,42 @@ struct hashtable
     size_t capacity;       // Number of elements table can hold
     size_t threshold;      // Maximum elements table can hold before resizing
     double load_factor;
-    size_t cap_index;      // Index of capacity in global array
+    HashPolicy policy;     // Whether capacity is prime or a power of two
+    size_t cap_index;      // Index of capacity in global array, used by prime policy
+    Node *old_buckets;     // Buckets of previous table while it's being rehashed incrementally, NULL otherwise
+    size_t old_capacity;   // Number of buckets in previous table
+    size_t rehash_index;   // Index of next bucket of previous table to be moved
+    bool incremental;      // If true, buckets are moved a few at a time instead of all at once
+    bool shrink;           // If true, table shrinks when most of its elements have been removed
+    size_t threads;        // Maximum number of threads that move elements when table is rehashed
+    RBTree *trees;         // Tree of every bucket whose chain grew too long, NULL if no bucket has one
+    RBTree *old_trees;     // Trees of previous table while it's being rehashed
+    size_t seed;           // Random seed mixed into every hash
     hashFunc key_hash;
     cmpFunc key_cmp;
     destroyFunc key_destroy;
     destroyFunc val_destroy;
+    node_pool pool;        // Pool that all nodes are allocated from
+#ifndef HASH_NO_STATS
+    hash_counters stats;
+#endif
     int flag;
 };
 
+// A set is a table whose nodes have no values
+struct hashset
+{
+    struct hashtable table;
+};
+
+struct hash_iter
+{
+    Hashtable table;       // Table being traversed
+    size_t index;          // Index of bucket that holds current node
+    Node *link;            // Pointer to current node, either a bucket or the next field of previous node
+    bool removed;          // True if current node was removed, then link already points to the next node
+};
+
 
 // Table sizes are prime numbers for more efficient modulo operations
 size_t hash_sizes[] = {67, 131, 263, 523, 1049, 2099, 4201, 8389, 16787, 33577, 67153, 134293, 268573, 537143, 1074287, 2148599, 
@@ -37,14 +119,143 @@ size_t hash_sizes[] = {67, 131, 263, 523, 1049, 2099, 4201, 8389, 16787, 33577,
 
 
 
+////////////////////////////////////// FUNCTIONS FOR HASHES ///////////////////////////////////////
+
+// Return hash of key that is stored in its node
+static inline size_t table_hash(Hashtable table, void *key)
+{
+    return hash_mix64(table->key_hash(key) ^ table->seed);
+}
+
+// Return index of bucket for hash in an array of capacity buckets
+static inline size_t bucket_index(Hashtable table, size_t hash, size_t capacity)
+{
+    return table->policy == HASH_POW2 ? hash & (capacity - 1) : hash % capacity;
+}
+
+// Return number of buckets a new table starts with
+static inline size_t initial_capacity(HashPolicy policy)
+{
+    return policy == HASH_POW2 ? POW2_MIN_CAPACITY : hash_sizes[0];
+}
+
+
+
+/////////////////////////////////////// FUNCTIONS FOR STATS ///////////////////////////////////////
+
+// Record a search that visited probes nodes and found its key if found is true
+static inline void stats_search(Hashtable table, bool found, size_t probes)
+{
+#ifndef HASH_NO_STATS
+    if (found)
+    {
+        table->stats.hits++;
+        table->stats.hit_probes += probes;
+    }
+    else
+    {
+        table->stats.misses++;
+        table->stats.miss_probes += probes;
+    }
+#else
+    (void) table; (void) found; (void) probes;
+#endif
+}
+
+// Return current time in nanoseconds, used to time rehashing
+static inline uint64_t stats_clock(void)
+{
+#ifndef HASH_NO_STATS
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+// Add time since start to the time spent rehashing
+static inline void stats_rehash_time(Hashtable table, uint64_t start)
+{
+#ifndef HASH_NO_STATS
+    table->stats.rehash_ns += stats_clock() - start;
+#else
+    (void) table; (void) start;
+#endif
+}
+
+
+
+//////////////////////////////////// FUNCTIONS FOR NODE POOL ////////////////////////////////////
+
+// Initialize an empty pool of nodes of given size, no memory is allocated until the first node is needed
+static void pool_init(node_pool *pool, size_t node_size)
+{
+    pool->slabs = NULL;
+    pool->free_nodes = NULL;
+    pool->slab_used = pool->slab_nodes = 0;
+    pool->node_size = node_size;
+}
+
+// Return an unused node, or NULL in case of failure
+static Node pool_alloc(node_pool *pool)
+{
+    // Reuse node that was returned to the pool
+    if (pool->free_nodes)
+    {
+        Node node = pool->free_nodes;
+        pool->free_nodes = node->next;
+        return node;
+    }
+
+    // Allocate a new slab when the newest one runs out, each slab twice as big as the previous one
+    if (pool->slab_used == pool->slab_nodes)
+    {
+        size_t slab_nodes = pool->slabs ? pool->slab_nodes * 2 : SLAB_MIN_NODES;
+        if (slab_nodes > SLAB_MAX_NODES) slab_nodes = SLAB_MAX_NODES;
+
+        Slab slab = malloc(sizeof(struct slab) + slab_nodes * pool->node_size);
+        if (!slab) return NULL;
+
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->slab_nodes = slab_nodes;
+        pool->slab_used = 0;
+    }
+
+    return (Node) (pool->slabs->nodes + pool->slab_used++ * pool->node_size);
+}
+
+// Return node to the pool so that it can be reused
+static inline void pool_free(node_pool *pool, Node node)
+{
+    node->next = pool->free_nodes;
+    pool->free_nodes = node;
+}
+
+// Free every slab of the pool at once, along with all nodes allocated from them
+static void pool_release(node_pool *pool)
+{
+    while (pool->slabs)
+    {
+        Slab next_slab = pool->slabs->next;
+        free(pool->slabs);
+        pool->slabs = next_slab;
+    }
+
+    pool_init(pool, pool->node_size);
+}
+
+
+
 ////////////////////////////////////// FUNCTIONS FOR BUCKETS //////////////////////////////////////
 
-// Free memory allocated for node
-void node_destroy(Node node, destroyFunc key_destroy, destroyFunc val_destroy)
+// Free memory allocated for node's key and value and return node to the pool
+void node_destroy(Hashtable table, Node node)
 {
-    if (key_destroy) key_destroy(node->key);
-    if (val_destroy) val_destroy(node->value);
-    free(node);
+    if (table->key_destroy) table->key_destroy(node->key);
+    if (table->val_destroy) table->val_destroy(node->value);
+    pool_free(&table->pool, node);
 }
 
 // Insert node at the start of the bucket
@@ -55,15 +266,18 @@ Node bucket_insert_node(Node bucket, Node node)
 }
 
 // Insert a key-value pair at the start of the bucket
-Node bucket_insert(Node bucket, void *key, void *value, size_t hash)
+Node bucket_insert(Hashtable table, Node bucket, void *key, void *value, size_t hash)
 {
-    Node node = malloc(sizeof(struct node));
+    Node node = pool_alloc(&table->pool);
     if (!node) return NULL;
 
     node->key = key;
-    node->value = value;
     node->hash = hash;
 
+    // Nodes of sets have no value field
+    if (table->pool.node_size != SET_NODE_SIZE)
+        node->value = value;
+
     return bucket_insert_node(bucket, node);
 }
 
@@ -76,28 +290,34 @@ Node bucket_search(Node bucket, void *key, cmpFunc key_cmp)
     return bucket;
 }
 
-// Return true if bucket already contains key and replace both key and value
-bool bucket_replace(Node bucket, void *key, void *value, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+// Return node of bucket that holds key, or NULL if such node does not exist
+// Set length to number of nodes visited, which is the length of the bucket if key is not in it
+static Node bucket_search_count(Node bucket, void *key, cmpFunc key_cmp, size_t *length)
 {
-    // Search bucket for key
-    bucket = bucket_search(bucket, key, key_cmp);
+    size_t count = 0;
 
-    // If bucket contains key, replace key and value
-    if (bucket)
+    while (bucket && key_cmp(key, bucket->key))
     {
-        if (key_destroy) key_destroy(bucket->key);
-        if (val_destroy) val_destroy(bucket->value);
-
-        bucket->key = key;
-        bucket->value = value;
-        return true;
+        bucket = bucket->next;
+        count++;
     }
-    
+
+    *length = count;
+    return bucket;
+}
+
+// Return true if bucket has more than length nodes, at most length + 1 nodes are visited
+static bool bucket_longer(Node bucket, size_t length)
+{
+    for (size_t count = 0; bucket; bucket = bucket->next)
+        if (++count > length)
+            return true;
+
     return false;
 }
 
 // Remove key and value from the bucket, set found to true if bucket contains key
-Node bucket_remove(Node bucket, void *key, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy, bool *found)
+Node bucket_remove(Hashtable table, Node bucket, void *key, bool *found)
 {
     Node cur_node = bucket;
     *found = false;
@@ -106,11 +326,11 @@ Node bucket_remove(Node bucket, void *key, cmpFunc key_cmp, destroyFunc key_dest
     if (!cur_node) return NULL;
 
     // If key is in the head node
-    if (!key_cmp(key, cur_node->key))
+    if (!table->key_cmp(key, cur_node->key))
     {
         // Save next node and destroy current head
         Node temp_node = cur_node->next;
-        node_destroy(cur_node, key_destroy, val_destroy);
+        node_destroy(table, cur_node);
         *found = true;
 
         // Return new head
@@ -121,7 +341,7 @@ Node bucket_remove(Node bucket, void *key, cmpFunc key_cmp, destroyFunc key_dest
     Node prev_node = cur_node;
     cur_node = cur_node->next;
 
-    while (cur_node && key_cmp(key, cur_node->key))
+    while (cur_node && table->key_cmp(key, cur_node->key))
     {
         prev_node = cur_node;
         cur_node = cur_node->next;
@@ -131,224 +351,1049 @@ Node bucket_remove(Node bucket, void *key, cmpFunc key_cmp, destroyFunc key_dest
     if (cur_node) 
     {
         prev_node->next = cur_node->next;
-        node_destroy(cur_node, key_destroy, val_destroy);
+        node_destroy(table, cur_node);
         *found = true;
     }
 
     return bucket;
 }
 
-// Free memory for every node in bucket
-void bucket_destroy(Node bucket, destroyFunc key_destroy, destroyFunc val_destroy)
+// Free memory for key and value of every node in bucket, nodes themselves are freed with the pool
+void bucket_destroy(Hashtable table, Node bucket)
 {
-    if (!bucket) return;
-
-    Node next_node = bucket->next;
-
-    while (bucket && bucket->next)
+    for (; bucket; bucket = bucket->next)
     {
-        node_destroy(bucket, key_destroy, val_destroy);
-        bucket = next_node;
-        next_node = bucket->next;
+        if (table->key_destroy) table->key_destroy(bucket->key);
+        if (table->val_destroy) table->val_destroy(bucket->value);
     }
-
-    node_destroy(bucket, key_destroy, val_destroy);
 }
 
 
 
-////////////////////////////////////// FUNCTIONS FOR RESIZING /////////////////////////////////////
+///////////////////////////////////// FUNCTIONS FOR TREES /////////////////////////////////////////
 
-// Rehash elements of table to table of new capacity, return true if successful
-bool rehash(Hashtable table, size_t new_capacity)
+// A bucket whose chain grows past TREEIFY_THRESHOLD nodes also gets a Red-Black
+// Tree of its nodes, ordered by hash and then by key_cmp. Searches use the tree
+// instead of walking the chain, so crafted keys that all land in one bucket
+// can't make lookups linear. The chain is kept as it is, so every other
+// function that goes through buckets works the same. Every node added to or
+// removed from a treeified chain is added to or removed from its tree too.
+
+// Key-compare function of the table whose tree is being used, since cmp functions of trees
+// can't reach the table
+static _Thread_local cmpFunc tree_key_cmp;
+
+// Compare nodes by hash, then by key
+static int tree_cmp(const void *node1, const void *node2)
 {
-    // Save old capacity and buckets and change old values
-    size_t old_capacity = table->capacity;
-    Node *old_buckets = table->buckets;
+    const struct node *n1 = node1, *n2 = node2;
 
-    table->capacity = new_capacity;
-    table->threshold = table->capacity * table->load_factor;
+    if (n1->hash != n2->hash)
+        return n1->hash < n2->hash ? -1 : 1;
 
-    table->buckets = calloc(table->capacity, sizeof(Node));
-    if (!table->buckets) return false;
+    return tree_key_cmp(n1->key, n2->key);
+}
+
+// Return node of tree that holds key, or NULL if such node does not exist
+static Node tree_search(Hashtable table, RBTree tree, void *key, size_t hash)
+{
+    struct node probe = {.key = key, .hash = hash};
+
+    tree_key_cmp = table->key_cmp;
+    return rbt_search(tree, &probe);
+}
 
-    // Go through every bucket in old table
-    for (size_t i = 0; i < old_capacity; i++)
+// Give bucket at index of current table a tree of its nodes, if it doesn't have one already
+// In case of failure bucket is left without a tree and is searched linearly
+static void bucket_treeify(Hashtable table, size_t index)
+{
+    if (!table->trees)
     {
-        Node cur_node = old_buckets[i];
-        if (!cur_node) continue;
+        table->trees = calloc(table->capacity, sizeof(RBTree));
+        if (!table->trees) return;
+    }
 
-        Node next_node = cur_node->next;
+    if (table->trees[index]) return;
 
-        // Insert every node to new table
-        while (next_node)
-        {
-            size_t index = cur_node->hash % table->capacity;
-            table->buckets[index] = bucket_insert_node(table->buckets[index], cur_node);
+    RBTree tree = rbt_init(tree_cmp, NULL);
+    if (!tree) return;
 
-            cur_node = next_node;
-            next_node = cur_node->next; 
-        }
+    tree_key_cmp = table->key_cmp;
 
-        size_t index = cur_node->hash % table->capacity;
-        table->buckets[index] = bucket_insert_node(table->buckets[index], cur_node);
+    for (Node node = table->buckets[index]; node; node = node->next)
+    {
+        if (!rbt_insert(tree, node))
+        {
+            rbt_destroy(tree);
+            return;
+        }
     }
 
-    free(old_buckets);
-    return true;
+    table->trees[index] = tree;
 }
 
-// Check if table needs resizing, return false only if resizing was unsuccessful
-bool hash_resize(Hashtable table)
+// Add node that was inserted in bucket at index of current table to the bucket's tree
+// If node can't be added, tree is destroyed and bucket is searched linearly
+static void tree_add_node(Hashtable table, size_t index, Node node)
 {
-    while (table->size >= table->threshold)
+    tree_key_cmp = table->key_cmp;
+
+    if (!rbt_insert(table->trees[index], node))
     {
-        if (table->capacity >= MAX_PRIME)
-            return rehash(table, table->capacity * 2);
+        rbt_destroy(table->trees[index]);
+        table->trees[index] = NULL;
+    }
+}
+
+// Remove node from tree of bucket at index, destroy tree once the bucket is short again
+static void tree_remove_node(Hashtable table, RBTree *trees, size_t index, Node node)
+{
+    tree_key_cmp = table->key_cmp;
+    rbt_remove(trees[index], node);
 
-        return rehash(table, hash_sizes[++table->cap_index]);
+    if (rbt_size(trees[index]) < UNTREEIFY_THRESHOLD)
+    {
+        rbt_destroy(trees[index]);
+        trees[index] = NULL;
     }
-    return true;
 }
 
+// Destroy every tree of array of capacity buckets and free array
+static void trees_destroy(RBTree *trees, size_t capacity)
+{
+    if (!trees) return;
 
-///////////////////////////////////////// MAIN FUNCTIONS ///////////////////////////////////////////
+    for (size_t i = 0; i < capacity; i++)
+        if (trees[i]) rbt_destroy(trees[i]);
 
+    free(trees);
+}
 
-Hashtable hash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+// Return node that holds key in bucket at index of given buckets, searching the tree of the bucket if it has one
+// Add number of nodes visited to probes, a search in a tree counts as one
+static inline Node bucket_find(Hashtable table, Node *buckets, RBTree *trees, size_t index, void *key, size_t hash, size_t *probes)
 {
-    if (!key_hash || !key_cmp)
-        return NULL;
+    if (trees && trees[index])
+    {
+        (*probes)++;
+        return tree_search(table, trees[index], key, hash);
+    }
 
-    Hashtable table = malloc(sizeof(struct hashtable));
-    if (!table) return NULL;
+    size_t length;
+    Node node = bucket_search_count(buckets[index], key, table->key_cmp, &length);
 
-    table->cap_index = 0;
-    table->capacity = hash_sizes[0];
-    table->size = 0;
-    table->load_factor = LOAD_FACTOR;
-    table->threshold = table->capacity * table->load_factor;
+    *probes += node ? length + 1 : length;
+    return node;
+}
 
-    table->buckets = calloc(table->capacity, sizeof(Node));
+// Remove node that holds key from bucket at index of given buckets, return true if bucket contains key
+static bool bucket_find_remove(Hashtable table, Node *buckets, RBTree *trees, size_t index, void *key, size_t hash)
+{
+    bool found;
 
-    if (!table->buckets)
+    if (!trees || !trees[index])
     {
-        free(table); return NULL;
+        buckets[index] = bucket_remove(table, buckets[index], key, &found);
+        return found;
     }
 
-    table->key_hash = key_hash;
-    table->key_cmp = key_cmp;
-    table->val_destroy = val_destroy;
-    table->key_destroy = key_destroy;
-    table->flag = OK;
+    // Find node through the tree, then unlink it from the chain
+    Node node = tree_search(table, trees[index], key, hash);
+    if (!node) return false;
 
-    return table;
-}
+    tree_remove_node(table, trees, index, node);
 
-bool hash_empty(Hashtable table)
-{
-    return (table->size == 0);
+    Node *link = buckets + index;
+    while (*link != node)
+        link = &(*link)->next;
+
+    *link = node->next;
+    node_destroy(table, node);
+    return true;
 }
 
-size_t hash_size(Hashtable table)
+
+
+// Destroy keys and values of every node in table and free all nodes and the previous table
+// Buckets of the current table are left as they are
+static void table_destroy_nodes(Hashtable table)
 {
-    return table->size;
+    // Buckets only need to be traversed if their elements must be destroyed
+    if (table->key_destroy || table->val_destroy)
+    {
+        for (size_t i = 0; i < table->capacity; i++)
+            bucket_destroy(table, table->buckets[i]);
+
+        // Elements that have not been moved from the previous table
+        if (table->old_buckets)
+            for (size_t i = table->rehash_index; i < table->old_capacity; i++)
+                bucket_destroy(table, table->old_buckets[i]);
+    }
+
+    pool_release(&table->pool);
+
+    free(table->old_buckets);
+    table->old_buckets = NULL;
+    table->size = 0;
+
+    trees_destroy(table->trees, table->capacity);
+    trees_destroy(table->old_trees, table->old_capacity);
+    table->trees = table->old_trees = NULL;
 }
 
-bool hash_insert(Hashtable table, void *key, void *value)
+
+
+////////////////////////////////////// FUNCTIONS FOR RESIZING /////////////////////////////////////
+
+// Move every node of bucket to the current table
+// If bucket had a tree, its nodes may land in one bucket again, so buckets they're moved to are given trees too
+static void rehash_bucket(Hashtable table, Node bucket, bool had_tree)
 {
-    // Resize table if necessary
-    if (!hash_resize(table))
+    while (bucket)
     {
-        table->flag = ALLOC;
-        return false;
+        Node next_node = bucket->next;
+
+        size_t index = bucket_index(table, bucket->hash, table->capacity);
+        table->buckets[index] = bucket_insert_node(table->buckets[index], bucket);
+
+        if (table->trees && table->trees[index])
+            tree_add_node(table, index, bucket);
+        else if (had_tree && bucket_longer(table->buckets[index], TREEIFY_THRESHOLD))
+            bucket_treeify(table, index);
+
+        bucket = next_node;
     }
+}
 
-    // Get hash and index of key
-    size_t hash = table->key_hash(key);
-    size_t index = hash % table->capacity;
+// Move up to steps buckets of previous table to current table, free previous table once it's empty
+static void rehash_step(Hashtable table, size_t steps)
+{
+    uint64_t start = stats_clock();
 
-    // Check if key is already in table
-    if (bucket_replace(table->buckets[index], key, value, table->key_cmp, table->key_destroy, table->val_destroy))
-        return true;
+    while (steps-- && table->rehash_index < table->old_capacity)
+    {
+        size_t index = table->rehash_index++;
+        bool had_tree = table->old_trees && table->old_trees[index];
 
-    // If not, insert it at that index
-    Node new_bucket = bucket_insert(table->buckets[index], key, value, hash);
+        if (had_tree)
+        {
+            rbt_destroy(table->old_trees[index]);
+            table->old_trees[index] = NULL;
+        }
 
-    if (!new_bucket) 
+        rehash_bucket(table, table->old_buckets[index], had_tree);
+        table->old_buckets[index] = NULL;
+    }
+
+    if (table->rehash_index == table->old_capacity)
     {
-        table->flag = ALLOC;
-        return false;
+        free(table->old_buckets);
+        free(table->old_trees);
+        table->old_buckets = NULL;
+        table->old_trees = NULL;
     }
 
-    table->buckets[index] = new_bucket;
-    table->size++;
-    return true;
+    stats_rehash_time(table, start);
 }
 
-void *hash_search(Hashtable table, void *key)
+// Buckets of previous table moved by the threads of a parallel rehash
+typedef struct rehash_job
 {
-    size_t index = table->key_hash(key) % table->capacity;
-    Node node = bucket_search(table->buckets[index], key, table->key_cmp);
-    
-    if (!node) return NULL;
-    return node->value;
+    Hashtable table;
+    size_t tasks;          // Number of ranges buckets are split into
 }
+rehash_job;
 
-bool hash_remove(Hashtable table, void *key)
+// Move every bucket without a tree in range task of previous table to current table
+// Nodes are inserted at the head of their new bucket atomically, since other threads insert into the same buckets
+static void rehash_range(void *ctx, size_t task)
 {
-    size_t index = table->key_hash(key) % table->capacity;
-    bool found;
+    rehash_job *job = ctx;
+    Hashtable table = job->table;
 
-    table->buckets[index] = bucket_remove(table->buckets[index], key, table->key_cmp, table->key_destroy, table->val_destroy, &found);
+    size_t start = table->old_capacity * task / job->tasks;
+    size_t end = table->old_capacity * (task + 1) / job->tasks;
 
-    if (found) table->size--;
-    return found;
+    for (size_t i = start; i < end; i++)
+    {
+        // Buckets with trees are moved afterwards by one thread, since their trees must be rebuilt
+        if (table->old_trees && table->old_trees[i])
+            continue;
+
+        Node node = table->old_buckets[i];
+        table->old_buckets[i] = NULL;
+
+        while (node)
+        {
+            Node next_node = node->next;
+            Node *bucket = table->buckets + bucket_index(table, node->hash, table->capacity);
+            Node head = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+
+            do node->next = head;
+            while (!__atomic_compare_exchange_n(bucket, &head, node, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+            node = next_node;
+        }
+    }
 }
 
-bool hash_clear(Hashtable table)
+// Move elements of previous table to current table with the threads of the pool
+// Buckets that are left are moved by rehash_step
+static void rehash_parallel(Hashtable table)
 {
-    for (size_t i = 0; i < table->capacity; i++)
-        bucket_destroy(table->buckets[i], table->key_destroy, table->val_destroy);
+    size_t threads = table->threads < threadpool_threads() ? table->threads : threadpool_threads();
 
-    free(table->buckets);
+    rehash_job job = {.table = table, .tasks = threads * TASKS_PER_THREAD};
+    if (job.tasks > table->old_capacity) job.tasks = table->old_capacity;
 
-    table->cap_index = 0;
-    table->capacity = hash_sizes[0];
-    table->size = 0;
-    table->threshold = table->capacity * table->load_factor;
+    threadpool_run(job.tasks, threads, rehash_range, &job);
+}
 
-    table->buckets = calloc(table->capacity, sizeof(Node));
+// Rehash elements of table to table of new capacity, return true if successful
+// If table is incremental, elements stay in previous table and are moved by later operations
+bool rehash(Hashtable table, size_t new_capacity)
+{
+    // Previous incremental rehash must be completed before starting a new one
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    uint64_t start = stats_clock();
+
+    Node *new_buckets = calloc(new_capacity, sizeof(Node));
+    if (!new_buckets) return false;
+
+#ifndef HASH_NO_STATS
+    table->stats.rehashes++;
+#endif
+
+    // Save old capacity and buckets and change old values
+    table->old_capacity = table->capacity;
+    table->old_buckets = table->buckets;
+    table->old_trees = table->trees;
+    table->trees = NULL;
+    table->rehash_index = 0;
+
+    table->buckets = new_buckets;
+    table->capacity = new_capacity;
+    table->threshold = table->capacity * table->load_factor;
 
-    if (!table->buckets)
+    // Move every bucket now unless table is incremental, large tables are split between threads if allowed
+    if (!table->incremental)
     {
-        table->flag = ALLOC;
-        return false;
+        if (table->threads > 1 && table->size >= PARALLEL_REHASH_MIN)
+            rehash_parallel(table);
+
+        // Buckets that are left are timed by rehash_step
+        stats_rehash_time(table, start);
+        rehash_step(table, table->old_capacity);
     }
+    else stats_rehash_time(table, start);
 
     return true;
 }
 
-void hash_destroy(Hashtable table)
+// Check if table needs resizing, return false only if resizing was unsuccessful
+bool hash_resize(Hashtable table)
 {
-    for (size_t i = 0; i < table->capacity; i++)
-        bucket_destroy(table->buckets[i], table->key_destroy, table->val_destroy);
+    while (table->size >= table->threshold)
+    {
+        if (table->policy == HASH_POW2 || table->capacity >= MAX_PRIME)
+        {
+            if (table->capacity > __SIZE_MAX__ / 2) return false;
+            return rehash(table, table->capacity * 2);
+        }
 
-    free(table->buckets);
-    free(table);
-}
+        // Index only moves on once the table has actually grown
+        if (!rehash(table, hash_sizes[table->cap_index + 1]))
+            return false;
 
-double hash_load_factor(Hashtable table)
-{
-    return table->load_factor;
+        table->cap_index++;
+        return true;
+    }
+    return true;
 }
 
-void hash_set_key_destroy(Hashtable table, destroyFunc key_destroy)
+// Return smallest capacity of table's policy that can hold n elements without resizing, or 0 if it would overflow
+// Set cap_index to index of that capacity in global array
+static size_t capacity_for(Hashtable table, size_t n, size_t *cap_index)
 {
-    table->key_destroy = key_destroy;
+    size_t index = 0;
+    size_t capacity = initial_capacity(table->policy);
+
+    while (true)
+    {
+        double max_load = capacity * table->load_factor;
+        if (max_load >= (double) __SIZE_MAX__ || n < (size_t) max_load)
+            break;
+
+        if (table->policy == HASH_POW2 || capacity >= MAX_PRIME)
+        {
+            if (capacity > __SIZE_MAX__ / 2) return 0;
+            capacity *= 2;
+        }
+        else capacity = hash_sizes[++index];
+    }
+
+    *cap_index = index;
+    return capacity;
 }
 
-void hash_set_val_destroy(Hashtable table, destroyFunc val_destroy)
+// Rehash table to smallest capacity that can hold n elements, if that is smaller than current capacity
+// Return true if successful
+static bool table_shrink(Hashtable table, size_t n)
+{
+    size_t cap_index;
+    size_t capacity = capacity_for(table, n, &cap_index);
+
+    if (!capacity || capacity >= table->capacity)
+        return true;
+
+    if (!rehash(table, capacity))
+        return false;
+
+    table->cap_index = cap_index;
+    return true;
+}
+
+// Check if table should shrink after a removal, return false only if shrinking was unsuccessful
+// Table shrinks to twice the capacity its elements need, so it's far from both the growing
+// and the shrinking threshold afterwards and removals and insertions around them don't keep
+// resizing it
+static bool hash_shrink(Hashtable table)
+{
+    // Don't start shrinking while a rehash is in progress
+    if (!table->shrink || table->old_buckets || table->size >= table->threshold / SHRINK_RATIO)
+        return true;
+
+    return table_shrink(table, table->size * 2);
+}
+
+
+//////////////////////////////////// FUNCTIONS FOR TRAVERSAL ////////////////////////////////////
+
+// Call fn for every pair in buckets, prefetching nodes of buckets ahead and of the next node in each chain
+static void buckets_foreach(Node *buckets, size_t start, size_t end, hashForeachFunc fn, void *ctx)
+{
+    for (size_t i = start; i < end; i++)
+    {
+        if (i + PREFETCH_DISTANCE < end && buckets[i + PREFETCH_DISTANCE])
+            __builtin_prefetch(buckets[i + PREFETCH_DISTANCE]);
+
+        for (Node node = buckets[i]; node; node = node->next)
+        {
+            if (node->next) __builtin_prefetch(node->next);
+            fn(node->key, node->value, ctx);
+        }
+    }
+}
+
+// Point iterator to first node of the first non-empty bucket from index onwards, return false if there is none
+static bool iter_next_bucket(HashIter iter, size_t index)
+{
+    Hashtable table = iter->table;
+
+    for (; index < table->capacity; index++)
+    {
+        if (table->buckets[index])
+        {
+            // Prefetch a bucket ahead, it will be visited soon
+            if (index + PREFETCH_DISTANCE < table->capacity && table->buckets[index + PREFETCH_DISTANCE])
+                __builtin_prefetch(table->buckets[index + PREFETCH_DISTANCE]);
+
+            iter->index = index;
+            iter->link = table->buckets + index;
+            return true;
+        }
+    }
+
+    iter->index = table->capacity;
+    iter->link = NULL;
+    return false;
+}
+
+// Compare two hashes for qsort
+static int hash_cmp(const void *a, const void *b)
+{
+    size_t x = *(const size_t *) a, y = *(const size_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Return true if two keys of table have equal hashes, false if not or if memory for the check can't be allocated
+// Keys have equal hashes exactly when their stored hashes are equal, since the seed is mixed in without losing bits
+static bool table_equal_hashes(Hashtable table)
+{
+    size_t *hashes = malloc(table->size * sizeof(size_t));
+    if (!hashes) return false;
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        for (Node node = table->buckets[i]; node; node = node->next)
+            hashes[n++] = node->hash;
+    }
+
+    qsort(hashes, n, sizeof(size_t), hash_cmp);
+
+    size_t i = 1;
+    while (i < n && hashes[i] != hashes[i - 1]) i++;
+
+    free(hashes);
+    return i < n;
+}
+
+
+
+//////////////////////////////////// FUNCTIONS FOR INSERTION ////////////////////////////////////
+
+// Return node that holds key with given hash, or insert a node for key if it's not in table and return that
+// Bucket of key is traversed once, value of a new node is left for the caller to set
+// Set inserted to true if a new node was created, return NULL in case of failure
+static Node table_upsert_hashed(Hashtable table, void *key, size_t hash, bool *inserted)
+{
+    size_t index = bucket_index(table, hash, table->capacity);
+    size_t length = 0, probes = 0;
+    Node node = NULL;
+
+    // Check if key is already in table, it could still be in the previous table
+    if (table->old_buckets)
+        node = bucket_find(table, table->old_buckets, table->old_trees, bucket_index(table, hash, table->old_capacity), key, hash, &probes);
+
+    if (!node)
+    {
+        if (table->trees && table->trees[index])
+        {
+            node = tree_search(table, table->trees[index], key, hash);
+            probes++;
+        }
+        else
+        {
+            node = bucket_search_count(table->buckets[index], key, table->key_cmp, &length);
+            probes += node ? length + 1 : length;
+        }
+    }
+
+    stats_search(table, node != NULL, probes);
+
+    *inserted = !node;
+    if (node) return node;
+
+    // If not, insert it at that index
+    Node new_bucket = bucket_insert(table, table->buckets[index], key, NULL, hash);
+
+    if (!new_bucket) 
+    {
+        table->flag = ALLOC;
+        return NULL;
+    }
+
+    table->buckets[index] = new_bucket;
+    table->size++;
+
+    // Keep tree of bucket up to date, or give bucket a tree if it has grown too long
+    if (table->trees && table->trees[index])
+        tree_add_node(table, index, new_bucket);
+    else if (length >= TREEIFY_THRESHOLD)
+        bucket_treeify(table, index);
+
+    return new_bucket;
+}
+
+// Return node that holds key, or insert a node for key if it's not in table and return that
+// Key is hashed once, set inserted to true if a new node was created, return NULL in case of failure
+static Node table_upsert(Hashtable table, void *key, bool *inserted)
+{
+    // Resize table if necessary
+    if (!hash_resize(table))
+    {
+        table->flag = ALLOC;
+        return NULL;
+    }
+
+    // Move some buckets if table is being rehashed
+    if (table->old_buckets)
+        rehash_step(table, REHASH_STEP);
+
+    return table_upsert_hashed(table, key, table_hash(table, key), inserted);
+}
+
+// Replace key and value of node with new ones, destroying the previous ones
+static inline void node_replace(Hashtable table, Node node, void *key, void *value)
+{
+    if (table->key_destroy) table->key_destroy(node->key);
+    if (table->val_destroy) table->val_destroy(node->value);
+
+    node->key = key;
+    node->value = value;
+}
+
+
+
+
+/////////////////////////////////// FUNCTIONS FOR SEARCH AND REMOVAL //////////////////////////////
+
+// Return node that holds key, or NULL if key is not in table
+static Node table_search(Hashtable table, void *key)
+{
+    if (table->old_buckets)
+        rehash_step(table, REHASH_STEP);
+
+    size_t hash = table_hash(table, key);
+    size_t probes = 0;
+    Node node = NULL;
+
+    // Search previous table first if it's being rehashed
+    if (table->old_buckets)
+        node = bucket_find(table, table->old_buckets, table->old_trees, bucket_index(table, hash, table->old_capacity), key, hash, &probes);
+
+    if (!node)
+        node = bucket_find(table, table->buckets, table->trees, bucket_index(table, hash, table->capacity), key, hash, &probes);
+
+    stats_search(table, node != NULL, probes);
+    return node;
+}
+
+// Remove and destroy node that holds key, return false if key is not in table
+static bool table_remove(Hashtable table, void *key)
+{
+    if (table->old_buckets)
+        rehash_step(table, REHASH_STEP);
+
+    size_t hash = table_hash(table, key);
+    bool found = false;
+
+    // Key could still be in previous table if it's being rehashed
+    if (table->old_buckets)
+        found = bucket_find_remove(table, table->old_buckets, table->old_trees, bucket_index(table, hash, table->old_capacity), key, hash);
+
+    if (!found)
+        found = bucket_find_remove(table, table->buckets, table->trees, bucket_index(table, hash, table->capacity), key, hash);
+
+    if (!found) return false;
+    table->size--;
+
+    // Element is removed even if the table can't shrink
+    if (!hash_shrink(table))
+        table->flag = ALLOC;
+
+    return true;
+}
+
+
+
+//////////////////////////////////////// FUNCTIONS FOR SETS ////////////////////////////////////////
+
+// Add key to set, replacing the equal key already in it, return true if successful
+static bool set_add(HashSet set, void *key)
+{
+    bool inserted;
+    Node node = table_upsert(&set->table, key, &inserted);
+    if (!node) return false;
+
+    if (!inserted && node->key != key)
+    {
+        if (set->table.key_destroy) set->table.key_destroy(node->key);
+        node->key = key;
+    }
+
+    return true;
+}
+
+// Add key to result if its presence in other matches in_other, or add it anyway if other is NULL
+// Key is copied if copy is not NULL, return false in case of failure
+static bool set_filter_key(HashSet result, HashSet other, bool in_other, copyFunc copy, void *key)
+{
+    if (other && (table_search(&other->table, key) != NULL) != in_other)
+        return true;
+
+    void *new_key = copy ? copy(key) : key;
+    if (!new_key) return false;
+
+    if (!set_add(result, new_key))
+    {
+        if (copy && result->table.key_destroy) result->table.key_destroy(new_key);
+        return false;
+    }
+
+    return true;
+}
+
+// Add every key of src that passes set_filter_key to result, return true if successful
+static bool set_filter(HashSet result, HashSet src, HashSet other, bool in_other, copyFunc copy)
+{
+    Hashtable table = &src->table;
+
+    for (size_t i = 0; i < table->capacity; i++)
+        for (Node node = table->buckets[i]; node; node = node->next)
+            if (!set_filter_key(result, other, in_other, copy, node->key))
+                return false;
+
+    return true;
+}
+
+// Return an empty set with the same functions and policy as set, which destroys its keys only if they are copies
+// Set can hold n keys without resizing
+static HashSet set_new_like(HashSet set, copyFunc copy, size_t n)
+{
+    Hashtable table = &set->table;
+    HashSet result = hashset_init_custom(table->policy, table->key_hash, table->key_cmp, copy ? table->key_destroy : NULL);
+
+    if (!result || !hash_reserve(&result->table, n))
+    {
+        if (result) hashset_destroy(result);
+        table->flag = ALLOC;
+        return NULL;
+    }
+
+    return result;
+}
+
+// Finish rehashing of both sets so that their buckets can be traversed while the other one is searched
+static void set_finish_rehash(HashSet a, HashSet b)
+{
+    if (a->table.old_buckets)
+        rehash_step(&a->table, a->table.old_capacity);
+
+    if (b->table.old_buckets)
+        rehash_step(&b->table, b->table.old_capacity);
+}
+
+// Destroy result of failed set operation and set flag of set
+static HashSet set_fail(HashSet set, HashSet result)
+{
+    hashset_destroy(result);
+    set->table.flag = ALLOC;
+    return NULL;
+}
+
+// Initialize fields of table whose nodes have given size, return true if successful
+static bool table_init(Hashtable table, HashPolicy policy, size_t node_size, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    table->policy = policy;
+    table->cap_index = 0;
+    table->capacity = initial_capacity(policy);
+    table->size = 0;
+    table->load_factor = LOAD_FACTOR;
+    table->threshold = table->capacity * table->load_factor;
+
+    table->buckets = calloc(table->capacity, sizeof(Node));
+    if (!table->buckets) return false;
+
+    table->old_buckets = NULL;
+    table->old_capacity = table->rehash_index = 0;
+    table->incremental = false;
+    table->shrink = true;
+    table->threads = 1;
+    table->trees = table->old_trees = NULL;
+    table->seed = hash_random_seed();
+    pool_init(&table->pool, node_size);
+
+#ifndef HASH_NO_STATS
+    memset(&table->stats, 0, sizeof(table->stats));
+#endif
+
+    table->key_hash = key_hash;
+    table->key_cmp = key_cmp;
+    table->val_destroy = val_destroy;
+    table->key_destroy = key_destroy;
+    table->flag = OK;
+
+    return true;
+}
+
+
+
+///////////////////////////////////////// MAIN FUNCTIONS ///////////////////////////////////////////
+
+
+Hashtable hash_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    return hash_init_custom(HASH_PRIME, key_hash, key_cmp, key_destroy, val_destroy);
+}
+
+Hashtable hash_init_custom(HashPolicy policy, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy, destroyFunc val_destroy)
+{
+    if (!key_hash || !key_cmp || (policy != HASH_PRIME && policy != HASH_POW2))
+        return NULL;
+
+    Hashtable table = malloc(sizeof(struct hashtable));
+    if (!table) return NULL;
+
+    if (!table_init(table, policy, sizeof(struct node), key_hash, key_cmp, key_destroy, val_destroy))
+    {
+        free(table); return NULL;
+    }
+
+    return table;
+}
+
+bool hash_empty(Hashtable table)
+{
+    return (table->size == 0);
+}
+
+size_t hash_size(Hashtable table)
+{
+    return table->size;
+}
+
+bool hash_insert(Hashtable table, void *key, void *value)
+{
+    bool inserted;
+    Node node = table_upsert(table, key, &inserted);
+    if (!node) return false;
+
+    // If key was already in table, replace both key and value
+    if (!inserted)
+        node_replace(table, node, key, value);
+    else
+        node->value = value;
+
+    return true;
+}
+
+bool hash_insert_bulk(Hashtable table, void **keys, void **values, size_t n)
+{
+    // Resize table once for every pair, then finish rehashing in progress,
+    // so that no insertion needs to check for resizing
+    if (n > __SIZE_MAX__ - table->size)
+    {
+        table->flag = ARG;
+        return false;
+    }
+
+    if (!hash_reserve(table, table->size + n))
+        return false;
+
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    size_t hashes[BATCH_SIZE];
+
+    for (size_t start = 0; start < n; start += BATCH_SIZE)
+    {
+        size_t count = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        // Hash every key and prefetch the bucket it belongs to
+        for (size_t i = 0; i < count; i++)
+        {
+            hashes[i] = table_hash(table, keys[start + i]);
+            __builtin_prefetch(table->buckets + bucket_index(table, hashes[i], table->capacity));
+        }
+
+        // Link every pair into its bucket
+        for (size_t i = 0; i < count; i++)
+        {
+            bool inserted;
+            Node node = table_upsert_hashed(table, keys[start + i], hashes[i], &inserted);
+            if (!node) return false;
+
+            if (!inserted)
+                node_replace(table, node, keys[start + i], values[start + i]);
+            else
+                node->value = values[start + i];
+        }
+    }
+
+    return true;
+}
+
+bool hash_reserve(Hashtable table, size_t n)
+{
+    size_t cap_index;
+    size_t capacity = capacity_for(table, n, &cap_index);
+
+    // No capacity can hold n elements
+    if (!capacity)
+    {
+        table->flag = ARG;
+        return false;
+    }
+
+    if (capacity <= table->capacity)
+        return true;
+
+    if (!rehash(table, capacity))
+    {
+        table->flag = ALLOC;
+        return false;
+    }
+
+    table->cap_index = cap_index;
+
+    // Reserved buckets are ready at once, even if table is incremental
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    return true;
+}
+
+void **hash_upsert(Hashtable table, void *key, bool *inserted)
+{
+    bool new_node;
+    Node node = table_upsert(table, key, &new_node);
+    if (!node) return NULL;
+
+    if (new_node) node->value = NULL;
+    if (inserted) *inserted = new_node;
+
+    return &node->value;
+}
+
+void *hash_get_or_insert(Hashtable table, void *key, void *value)
+{
+    bool inserted;
+    Node node = table_upsert(table, key, &inserted);
+    if (!node) return NULL;
+
+    if (inserted) node->value = value;
+    return node->value;
+}
+
+void *hash_search(Hashtable table, void *key)
+{
+    Node node = table_search(table, key);
+    return node ? node->value : NULL;
+}
+
+size_t hash_search_batch(Hashtable table, void **keys, size_t n, void **values)
+{
+    if (table->old_buckets)
+        rehash_step(table, REHASH_STEP);
+
+    size_t hashes[BATCH_SIZE];
+    Node *buckets[BATCH_SIZE];
+    Node heads[BATCH_SIZE];
+    size_t found = 0;
+
+    for (size_t start = 0; start < n; start += BATCH_SIZE)
+    {
+        size_t count = n - start < BATCH_SIZE ? n - start : BATCH_SIZE;
+
+        // Hash every key and prefetch the bucket it belongs to
+        for (size_t i = 0; i < count; i++)
+        {
+            hashes[i] = table_hash(table, keys[start + i]);
+            buckets[i] = table->buckets + bucket_index(table, hashes[i], table->capacity);
+            __builtin_prefetch(buckets[i]);
+        }
+
+        // Read bucket heads and prefetch their first nodes
+        for (size_t i = 0; i < count; i++)
+        {
+            heads[i] = *buckets[i];
+            if (heads[i]) __builtin_prefetch(heads[i]);
+        }
+
+        // Nodes should now be in cache, search buckets for keys
+        for (size_t i = 0; i < count; i++)
+        {
+            Node node = NULL;
+            size_t probes = 0;
+
+            // Key could still be in previous table if it's being rehashed
+            if (table->old_buckets)
+                node = bucket_find(table, table->old_buckets, table->old_trees, bucket_index(table, hashes[i], table->old_capacity), keys[start + i], hashes[i], &probes);
+
+            if (!node)
+            {
+                size_t index = buckets[i] - table->buckets;
+
+                if (table->trees && table->trees[index])
+                {
+                    node = tree_search(table, table->trees[index], keys[start + i], hashes[i]);
+                    probes++;
+                }
+                else
+                {
+                    size_t length;
+                    node = bucket_search_count(heads[i], keys[start + i], table->key_cmp, &length);
+                    probes += node ? length + 1 : length;
+                }
+            }
+
+            stats_search(table, node != NULL, probes);
+
+            values[start + i] = node ? node->value : NULL;
+            if (node) found++;
+        }
+    }
+
+    return found;
+}
+
+bool hash_remove(Hashtable table, void *key)
+{
+    return table_remove(table, key);
+}
+
+bool hash_clear(Hashtable table)
+{
+    Node *buckets = calloc(initial_capacity(table->policy), sizeof(Node));
+
+    // If initial buckets can't be allocated, table is cleared but keeps its capacity
+    if (!buckets)
+    {
+        hash_clear_keep_capacity(table);
+        table->flag = ALLOC;
+        return false;
+    }
+
+    table_destroy_nodes(table);
+    free(table->buckets);
+
+    table->buckets = buckets;
+    table->cap_index = 0;
+    table->capacity = initial_capacity(table->policy);
+    table->threshold = table->capacity * table->load_factor;
+
+    return true;
+}
+
+void hash_clear_keep_capacity(Hashtable table)
+{
+    table_destroy_nodes(table);
+    memset(table->buckets, 0, table->capacity * sizeof(Node));
+}
+
+bool hash_shrink_to_fit(Hashtable table)
+{
+    if (!table_shrink(table, table->size))
+    {
+        table->flag = ALLOC;
+        return false;
+    }
+
+    // Table is rehashed at once, even if it's incremental
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    return true;
+}
+
+void hash_destroy(Hashtable table)
+{
+    table_destroy_nodes(table);
+    free(table->buckets);
+    free(table);
+}
+
+size_t hash_capacity(Hashtable table)
+{
+    return table->capacity;
+}
+
+double hash_load_factor(Hashtable table)
+{
+    return table->load_factor;
+}
+
+void hash_set_key_destroy(Hashtable table, destroyFunc key_destroy)
+{
+    table->key_destroy = key_destroy;
+}
+
+void hash_set_val_destroy(Hashtable table, destroyFunc val_destroy)
 {
     table->val_destroy = val_destroy;
 }
@@ -361,7 +1406,391 @@ bool hash_set_load_factor(Hashtable table, double load_factor)
     return hash_resize(table);
 }
 
+void hash_set_incremental(Hashtable table, bool incremental)
+{
+    table->incremental = incremental;
+
+    // Finish rehashing that is in progress
+    if (!incremental && table->old_buckets)
+        rehash_step(table, table->old_capacity);
+}
+
+bool hash_incremental(Hashtable table)
+{
+    return table->incremental;
+}
+
+void hash_stats(Hashtable table, HashStats *stats)
+{
+    memset(stats, 0, sizeof(HashStats));
+
+    stats->size = table->size;
+    stats->capacity = table->capacity;
+
+    // Chain lengths are found by going through every bucket, including the ones of the previous table not moved yet
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Node *buckets = pass ? table->old_buckets : table->buckets;
+        size_t start = pass ? table->rehash_index : 0;
+        size_t end = pass ? table->old_capacity : table->capacity;
+
+        if (!buckets) continue;
+
+        for (size_t i = start; i < end; i++)
+        {
+            size_t length = 0;
+
+            for (Node node = buckets[i]; node; node = node->next)
+                length++;
+
+            if (length) stats->used_buckets++;
+            if (length > stats->max_chain) stats->max_chain = length;
+
+            stats->chains[length < HASH_STATS_CHAINS ? length : HASH_STATS_CHAINS - 1]++;
+        }
+    }
+
+    for (size_t i = 0; table->trees && i < table->capacity; i++)
+        if (table->trees[i]) stats->tree_buckets++;
+
+#ifndef HASH_NO_STATS
+    stats->hits = table->stats.hits;
+    stats->misses = table->stats.misses;
+    stats->hit_probes = table->stats.hits ? (double) table->stats.hit_probes / table->stats.hits : 0;
+    stats->miss_probes = table->stats.misses ? (double) table->stats.miss_probes / table->stats.misses : 0;
+    stats->rehashes = table->stats.rehashes;
+    stats->rehash_time = table->stats.rehash_ns / 1e9;
+#endif
+}
+
+void hash_reset_stats(Hashtable table)
+{
+#ifndef HASH_NO_STATS
+    memset(&table->stats, 0, sizeof(table->stats));
+#else
+    (void) table;
+#endif
+}
+
+void hash_set_threads(Hashtable table, size_t threads)
+{
+    table->threads = threads ? threads : 1;
+}
+
+FrozenHash hash_freeze(Hashtable table)
+{
+    // Finish rehashing in progress so that every node is in the current buckets
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    void **keys = malloc(table->size * sizeof(void *));
+    void **values = malloc(table->size * sizeof(void *));
+    FrozenHash frozen = NULL;
+
+    if (keys && values)
+    {
+        size_t n = 0;
+
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            for (Node node = table->buckets[i]; node; node = node->next)
+            {
+                keys[n] = node->key;
+                values[n++] = node->value;
+            }
+        }
+
+        frozen = frozen_init(keys, values, n, table->key_hash, table->key_cmp, table->key_destroy, table->val_destroy);
+    }
+
+    free(keys);
+    free(values);
+
+    // Table is not changed, so its elements stay owned by it
+    if (!frozen)
+    {
+        table->flag = table_equal_hashes(table) ? HASH : ALLOC;
+        return NULL;
+    }
+
+    // Frozen table owns the elements now, so they are not destroyed when the table is cleared
+    destroyFunc key_destroy = table->key_destroy, val_destroy = table->val_destroy;
+    table->key_destroy = table->val_destroy = NULL;
+
+    hash_clear(table);
+
+    table->key_destroy = key_destroy;
+    table->val_destroy = val_destroy;
+    return frozen;
+}
+
+bool hash_randomize(Hashtable table)
+{
+    // Finish rehashing in progress so that every node is in the current buckets
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    size_t old_seed = table->seed;
+    table->seed = hash_random_seed();
+
+    // Hash of every node changes, so nodes are rehashed to a new array of the same capacity
+    // Nodes are only moved once their new hashes have been computed
+    bool incremental = table->incremental;
+    table->incremental = true;
+    bool rehashed = rehash(table, table->capacity);
+    table->incremental = incremental;
+
+    if (!rehashed)
+    {
+        table->seed = old_seed;
+        table->flag = ALLOC;
+        return false;
+    }
+
+    // Trees are ordered by the old hashes, they are only destroyed while nodes are moved
+    for (size_t i = 0; i < table->old_capacity; i++)
+        for (Node node = table->old_buckets[i]; node; node = node->next)
+            node->hash = table_hash(table, node->key);
+
+    rehash_step(table, table->old_capacity);
+    return true;
+}
+
+void hash_set_shrink(Hashtable table, bool shrink)
+{
+    table->shrink = shrink;
+}
+
+HashPolicy hash_policy(Hashtable table)
+{
+    return table->policy;
+}
+
+void hash_foreach(Hashtable table, hashForeachFunc fn, void *ctx)
+{
+    buckets_foreach(table->buckets, 0, table->capacity, fn, ctx);
+
+    // Pairs that have not been moved from the previous table
+    if (table->old_buckets)
+        buckets_foreach(table->old_buckets, table->rehash_index, table->old_capacity, fn, ctx);
+}
+
+HashIter hash_iter_begin(Hashtable table)
+{
+    HashIter iter = malloc(sizeof(struct hash_iter));
+    ERR_ALLOC(table, iter)
+
+    // Finish rehashing in progress so that every node is in the current buckets
+    if (table->old_buckets)
+        rehash_step(table, table->old_capacity);
+
+    iter->table = table;
+    iter->index = 0;
+    iter->link = NULL;
+    iter->removed = false;
+
+    return iter;
+}
+
+bool hash_iter_next(HashIter iter, void **key, void **value)
+{
+    // Iterator is positioned before the first node
+    if (!iter->link)
+    {
+        if (iter->index || !iter_next_bucket(iter, 0))
+            return false;
+    }
+    // Move past current node, unless it was removed and link already points to the next one
+    else
+    {
+        if (!iter->removed)
+            iter->link = &(*iter->link)->next;
+
+        iter->removed = false;
+
+        if (!*iter->link && !iter_next_bucket(iter, iter->index + 1))
+            return false;
+    }
+
+    Node node = *iter->link;
+    if (node->next) __builtin_prefetch(node->next);
+
+    if (key) *key = node->key;
+    if (value) *value = node->value;
+    return true;
+}
+
+bool hash_iter_remove(HashIter iter)
+{
+    // Iterator must be on a node that has not been removed
+    if (!iter->link || iter->removed)
+    {
+        iter->table->flag = ARG;
+        return false;
+    }
+
+    // Unlink current node, link now points to the next node
+    Node node = *iter->link;
+    *iter->link = node->next;
+
+    if (iter->table->trees && iter->table->trees[iter->index])
+        tree_remove_node(iter->table, iter->table->trees, iter->index, node);
+
+    node_destroy(iter->table, node);
+
+    iter->table->size--;
+    iter->removed = true;
+    return true;
+}
+
+void hash_iter_destroy(HashIter iter)
+{
+    free(iter);
+}
+
 int hash_flag(Hashtable table)
 {
     return table->flag;
-}
\ No newline at end of file
+}
+
+
+
+////////////////////////////////////////// SET FUNCTIONS ////////////////////////////////////////////
+
+
+HashSet hashset_init(hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy)
+{
+    return hashset_init_custom(HASH_PRIME, key_hash, key_cmp, key_destroy);
+}
+
+HashSet hashset_init_custom(HashPolicy policy, hashFunc key_hash, cmpFunc key_cmp, destroyFunc key_destroy)
+{
+    if (!key_hash || !key_cmp || (policy != HASH_PRIME && policy != HASH_POW2))
+        return NULL;
+
+    HashSet set = malloc(sizeof(struct hashset));
+    if (!set) return NULL;
+
+    // Nodes of set are allocated without their value field
+    if (!table_init(&set->table, policy, SET_NODE_SIZE, key_hash, key_cmp, key_destroy, NULL))
+    {
+        free(set); return NULL;
+    }
+
+    return set;
+}
+
+bool hashset_empty(HashSet set)
+{
+    return (set->table.size == 0);
+}
+
+size_t hashset_size(HashSet set)
+{
+    return set->table.size;
+}
+
+bool hashset_add(HashSet set, void *key)
+{
+    return set_add(set, key);
+}
+
+bool hashset_contains(HashSet set, void *key)
+{
+    return table_search(&set->table, key) != NULL;
+}
+
+bool hashset_remove(HashSet set, void *key)
+{
+    return table_remove(&set->table, key);
+}
+
+bool hashset_reserve(HashSet set, size_t n)
+{
+    return hash_reserve(&set->table, n);
+}
+
+HashSet hashset_union(HashSet a, HashSet b, copyFunc copy)
+{
+    set_finish_rehash(a, b);
+
+    // Every key of the larger set is added without a search, only keys of the smaller one are searched for
+    HashSet large = a->table.size >= b->table.size ? a : b;
+    HashSet small = large == a ? b : a;
+
+    HashSet result = set_new_like(a, copy, a->table.size + b->table.size);
+    if (!result) return NULL;
+
+    if (!set_filter(result, large, NULL, false, copy) || !set_filter(result, small, large, false, copy))
+        return set_fail(a, result);
+
+    return result;
+}
+
+HashSet hashset_intersection(HashSet a, HashSet b, copyFunc copy)
+{
+    set_finish_rehash(a, b);
+
+    // Keys of the smaller set are searched for in the larger one
+    HashSet large = a->table.size >= b->table.size ? a : b;
+    HashSet small = large == a ? b : a;
+
+    HashSet result = set_new_like(a, copy, small->table.size);
+    if (!result) return NULL;
+
+    if (!set_filter(result, small, large, true, copy))
+        return set_fail(a, result);
+
+    return result;
+}
+
+HashSet hashset_difference(HashSet a, HashSet b, copyFunc copy)
+{
+    set_finish_rehash(a, b);
+
+    HashSet result = set_new_like(a, copy, a->table.size);
+    if (!result) return NULL;
+
+    // If b is empty every key of a is kept, so b is not searched
+    if (!set_filter(result, a, b->table.size ? b : NULL, false, copy))
+        return set_fail(a, result);
+
+    return result;
+}
+
+void hashset_foreach(HashSet set, hashsetForeachFunc fn, void *ctx)
+{
+    Hashtable table = &set->table;
+
+    for (size_t i = 0; i < table->capacity; i++)
+        for (Node node = table->buckets[i]; node; node = node->next)
+            fn(node->key, ctx);
+
+    // Keys that have not been moved from the previous table
+    if (table->old_buckets)
+        for (size_t i = table->rehash_index; i < table->old_capacity; i++)
+            for (Node node = table->old_buckets[i]; node; node = node->next)
+                fn(node->key, ctx);
+}
+
+bool hashset_clear(HashSet set)
+{
+    return hash_clear(&set->table);
+}
+
+void hashset_destroy(HashSet set)
+{
+    table_destroy_nodes(&set->table);
+    free(set->table.buckets);
+    free(set);
+}
+
+void hashset_set_key_destroy(HashSet set, destroyFunc key_destroy)
+{
+    set->table.key_destroy = key_destroy;
+}
+
+int hashset_flag(HashSet set)
+{
+    return set->table.flag;
+}
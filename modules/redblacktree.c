@@ -593,7 +593,8 @@ bool rbt_remove(RBTree rbt, void *data)
 			rbt->size--;
 
 			// If root has changed, change pointer
-			if (!node_is_root(rbt->root))
+			// Rotations while fixing a double black can move the old root down two levels
+			while (!node_is_root(rbt->root))
 				rbt->root = rbt->root->parent;
 
 			return true;
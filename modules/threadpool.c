@@ -0,0 +1,148 @@
+#include "../include/threadpool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 255
+
+// State of the pool, every field is protected by lock except for next_task
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;            // Signaled when a job is posted
+    pthread_cond_t done;            // Signaled when the last worker leaves a job
+    size_t workers;                 // Number of workers that were started
+    unsigned long job;              // Number of jobs posted so far
+    taskFunc fn;                    // Function and context of current job
+    void *ctx;
+    size_t tasks;                   // Number of tasks of current job
+    size_t next_task;               // Next task to be run, taken atomically
+    size_t seats;                   // Number of workers that can still join current job
+    size_t active;                  // Number of workers running tasks of current job
+}
+pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .work = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+
+// Held by the caller whose job is running
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t start_once = PTHREAD_ONCE_INIT;
+
+
+
+//////////////////////////////////////// HELPER FUNCTIONS //////////////////////////////////////////
+
+// Run tasks of current job until none is left
+static void run_tasks(taskFunc fn, void *ctx, size_t tasks)
+{
+    size_t task;
+
+    while ((task = __atomic_fetch_add(&pool.next_task, 1, __ATOMIC_RELAXED)) < tasks)
+        fn(ctx, task);
+}
+
+// Wait for jobs and run their tasks
+static void *worker_main(void *arg)
+{
+    (void) arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+
+    while (true)
+    {
+        while (pool.job == seen)
+            pthread_cond_wait(&pool.work, &pool.lock);
+
+        seen = pool.job;
+
+        // Job may not need every worker
+        if (!pool.seats) continue;
+
+        pool.seats--;
+        pool.active++;
+
+        taskFunc fn = pool.fn;
+        void *ctx = pool.ctx;
+        size_t tasks = pool.tasks;
+
+        pthread_mutex_unlock(&pool.lock);
+        run_tasks(fn, ctx, tasks);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.active == 0)
+            pthread_cond_signal(&pool.done);
+    }
+
+    return NULL;
+}
+
+// Start one worker for every online processor but one
+static void start_workers(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t wanted = cpus > 1 ? cpus - 1 : 0;
+    if (wanted > MAX_WORKERS) wanted = MAX_WORKERS;
+
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr)) return;
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (size_t i = 0; i < wanted; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_main, NULL)) break;
+
+        pool.workers++;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+void threadpool_run(size_t ntasks, size_t nthreads, taskFunc fn, void *ctx)
+{
+    if (nthreads > ntasks)
+        nthreads = ntasks;
+
+    // Tasks run on calling thread if no other thread is needed or workers are busy
+    if (nthreads <= 1 || pthread_mutex_trylock(&run_lock))
+    {
+        for (size_t task = 0; task < ntasks; task++)
+            fn(ctx, task);
+        return;
+    }
+
+    pthread_once(&start_once, start_workers);
+
+    // Post job, then run tasks alongside the workers that join it
+    pthread_mutex_lock(&pool.lock);
+
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.tasks = ntasks;
+    pool.next_task = 0;
+    pool.seats = nthreads - 1 < pool.workers ? nthreads - 1 : pool.workers;
+    pool.job++;
+
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_tasks(fn, ctx, ntasks);
+
+    // Workers that haven't joined yet are not needed anymore, wait for the rest to finish
+    pthread_mutex_lock(&pool.lock);
+    pool.seats = 0;
+
+    while (pool.active)
+        pthread_cond_wait(&pool.done, &pool.lock);
+
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&run_lock);
+}
+
+size_t threadpool_threads(void)
+{
+    pthread_once(&start_once, start_workers);
+    return pool.workers + 1;
+}
@@ -1,5 +1,8 @@
 #include "../include/vector.h"
 #include "../include/flags.h"
+#include "../include/threadpool.h"
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #define MIN_CAPACITY 64     // Default minimum capacity
@@ -20,32 +23,54 @@ struct vector
 
 ///////////////////////////////////// STATIC FUNCTIONS //////////////////////////////////////////
 
-// Grow vector if vector size has reached its capacity 
-static inline bool vector_grow(Vector vector)
+// Grow vector with a single reallocation so that it can hold n more elements
+// Capacity is multiplied by the expansion factor as many times as needed, and only changes if reallocation succeeds
+static bool vector_grow_by(Vector vector, size_t n)
 {
-    if (vector->size == vector->capacity)
-    {
-        vector->capacity *= vector->exp_factor;
-        void **new_array = realloc(vector->array, vector->capacity * sizeof(void *));
+    size_t needed = vector->size + n;
+    if (needed <= vector->capacity) return true;
 
-        if (!new_array) return false;
-        vector->array = new_array;
+    size_t capacity = vector->capacity;
+    while (capacity < needed)
+    {
+        size_t grown = capacity * vector->exp_factor;
+        capacity = grown > capacity ? grown : capacity + 1;
     }
+
+    void **new_array = realloc(vector->array, capacity * sizeof(void *));
+    if (!new_array) return false;
+
+    vector->array = new_array;
+    vector->capacity = capacity;
     return true;
 }
 
+// Grow vector if vector size has reached its capacity
+static inline bool vector_grow(Vector vector)
+{
+    return vector_grow_by(vector, 1);
+}
+
 // Shrink vector if size is much smaller than capacity and new capacity >= min capacity
+// Capacity may step down several times after a range is removed, but the array is reallocated once
 static inline bool vector_shrink(Vector vector)
 {
-    while (vector->capacity >= 2 * vector->size * vector->exp_factor && vector->prev_cap >= vector->min_capacity)
-    {
-        vector->capacity = vector->prev_cap;
-        vector->prev_cap = vector->capacity / vector->exp_factor;
-        void **new_array = realloc(vector->array, vector->capacity * sizeof(void *));
+    size_t capacity = vector->capacity, prev_cap = vector->prev_cap;
 
-        if (!new_array) return false;
-        vector->array = new_array;
+    while (capacity >= 2 * vector->size * vector->exp_factor && prev_cap >= vector->min_capacity)
+    {
+        capacity = prev_cap;
+        prev_cap = capacity / vector->exp_factor;
     }
+
+    if (capacity == vector->capacity) return true;
+
+    void **new_array = realloc(vector->array, capacity * sizeof(void *));
+    if (!new_array) return false;
+
+    vector->array = new_array;
+    vector->capacity = capacity;
+    vector->prev_cap = prev_cap;
     return true;
 }
 
@@ -186,12 +211,38 @@ bool vector_insert(Vector vector, void *data, size_t index)
     if (!vector_grow(vector)) return false;
 
     // Shift elements and insert new element
-    memcpy(vector->array + index + 1, vector->array + index, (vector->size++ - index) * sizeof(void *));
+    memmove(vector->array + index + 1, vector->array + index, (vector->size++ - index) * sizeof(void *));
     vector->array[index] = data;
 
     return true;
 }
 
+bool vector_append_array(Vector vector, void **items, size_t k)
+{
+    return vector_insert_range(vector, vector->size, items, k);
+}
+
+bool vector_insert_range(Vector vector, size_t index, void **items, size_t k)
+{
+    ERR_BOUNDS(vector, index, vector->size + 1)
+
+    if (!k) return true;
+
+    // Grow vector once for all elements
+    if (!vector_grow_by(vector, k))
+    {
+        vector->flag = ALLOC;
+        return false;
+    }
+
+    // Shift elements from index onwards once and copy new elements in the gap
+    memmove(vector->array + index + k, vector->array + index, (vector->size - index) * sizeof(void *));
+    memcpy(vector->array + index, items, k * sizeof(void *));
+    vector->size += k;
+
+    return true;
+}
+
 bool vector_remove_first(Vector vector)
 {
     return vector_remove_at(vector, 0);
@@ -251,6 +302,35 @@ bool vector_remove_all(Vector vector, void *data, cmpFunc cmp)
     return true;
 }
 
+bool vector_erase_range(Vector vector, size_t start, size_t end)
+{
+    if (end < start)
+    {
+        vector->flag = ARG;
+        return false;
+    }
+
+    ERR_BOUNDS(vector, end, vector->size + 1)
+
+    // Destroy elements in range
+    if (vector->destroy)
+        for (size_t i = start; i < end; i++)
+            vector->destroy(vector->array[i]);
+
+    // Shift elements after the range once to fill it
+    memmove(vector->array + start, vector->array + end, (vector->size - end) * sizeof(void *));
+    vector->size -= end - start;
+
+    // Shrink vector if necessary
+    if (!vector_shrink(vector))
+    {
+        vector->flag = ALLOC;
+        return false;
+    }
+
+    return true;
+}
+
 void *vector_pop_first(Vector vector)
 {
     return vector_pop_at(vector, 0);
@@ -267,7 +347,7 @@ void *vector_pop_at(Vector vector, size_t index)
 
     // Save data at index and shift elements from the right to that position
     void *data = vector->array[index];
-    memcpy(vector->array + index, vector->array + index + 1, (--vector->size - index) * sizeof(void *));
+    memmove(vector->array + index, vector->array + index + 1, (--vector->size - index) * sizeof(void *));
 
     // Shrink vector if necessary
     if (!vector_shrink(vector)) vector->flag = ALLOC;
@@ -401,137 +481,1500 @@ bool vector_trim(Vector vector, size_t start, size_t end)
 }
 
 
-/////////////////////////////// HELPER FUNCTIONS FOR QUICKSORT //////////////////////////////////
+///////////////////////////////// HELPER FUNCTIONS FOR SORTING //////////////////////////////////
+
+// vector_sort is a pattern-defeating quicksort. Pivots are picked as the median of three elements,
+// or of three medians of three for large ranges, and ranges with many elements equal to the pivot
+// are split so that the equal ones are never sorted again. Partitions that find their range already
+// in order try to finish it with insertion sort, which makes sorted runs cost linear time, and
+// ranges that keep splitting badly are shuffled and finally sorted with heapsort, so sorting never
+// takes more than O(n log n) time. Only the smaller side of every partition is sorted recursively,
+// which keeps the depth of recursion logarithmic.
 
-// Perform partition to array and return pivot's index
-static size_t partition(void **array, size_t low, size_t high, cmpFunc cmp)
+#define INSERTION_SORT_MAX 24       // Ranges with fewer elements are sorted by insertion sort
+#define NINTHER_MIN 128             // Ranges with more elements pick their pivot as a median of medians
+#define PARTIAL_INSERTION_MAX 8     // Number of elements partial insertion sort moves before giving up
+
+// Sort range from begin to end by insertion sort
+static void insertion_sort(void **begin, void **end, cmpFunc cmp)
 {
-    void *pivot = array[high]; // Last element is the pivot
-    size_t i = low;            // Index where elements smaller than pivot are placed
-                               // Starts at the start of the array
+    if (begin == end) return;
 
-    // Traverse every element of the array
-    for (size_t j = low; j < high; j++)
+    for (void **cur = begin + 1; cur < end; cur++)
     {
-        // If element is smaller than pivot, place it in index i and increase index
-        if (cmp(array[j], pivot) < 0)
-            swap_elements(array + i++, array + j);
-    }
+        void *elem = *cur;
+        void **sift = cur;
 
-    // Put pivot after elements that are smaller and before elements that are greater
-    swap_elements(array + i, array + high);
+        // Shift greater elements to the right until place of element is found
+        for (; sift > begin && cmp(elem, sift[-1]) < 0; sift--)
+            *sift = sift[-1];
 
-    // Return pivot's position
-    return i;
+        *sift = elem;
+    }
 }
 
-// Sort array by quicksort
-static void quicksort(void **array, size_t low, size_t high, cmpFunc cmp)
+// Sort range from begin to end by insertion sort, where the element before begin is not greater than any element in range
+// That element stops every shift, so the start of the range doesn't need to be checked
+static void unguarded_insertion_sort(void **begin, void **end, cmpFunc cmp)
 {
-    // Perform partition, pivot index is returned
-    size_t pi = partition(array, low, high, cmp);
+    if (begin == end) return;
+
+    for (void **cur = begin + 1; cur < end; cur++)
+    {
+        void *elem = *cur;
+        void **sift = cur;
 
-    // Sort arrays left and right of pivot
-    if (pi > low) quicksort(array, low, pi-1, cmp);
-    if (pi < high) quicksort(array, pi+1, high, cmp);
+        for (; cmp(elem, sift[-1]) < 0; sift--)
+            *sift = sift[-1];
+
+        *sift = elem;
+    }
 }
 
-bool vector_sort(Vector vector, cmpFunc cmp)
+// Try to sort range from begin to end by insertion sort, return false if too many elements had to be moved
+// Range is left partially sorted in that case
+static bool partial_insertion_sort(void **begin, void **end, cmpFunc cmp)
 {
-    ERR_FUNC(vector, cmp)
+    if (begin == end) return true;
 
-    if (!vector->size)
-        return true;
+    size_t moved = 0;
+
+    for (void **cur = begin + 1; cur < end; cur++)
+    {
+        void *elem = *cur;
+        void **sift = cur;
+
+        for (; sift > begin && cmp(elem, sift[-1]) < 0; sift--)
+            *sift = sift[-1];
+
+        *sift = elem;
+        moved += cur - sift;
+
+        if (moved > PARTIAL_INSERTION_MAX) return false;
+    }
 
-    quicksort(vector->array, 0, vector->size-1, cmp);
     return true;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
+// Sort the three elements at a, b and c
+static inline void sort3(void **a, void **b, void **c, cmpFunc cmp)
+{
+    if (cmp(*b, *a) < 0) swap_elements(a, b);
+    if (cmp(*c, *b) < 0) swap_elements(b, c);
+    if (cmp(*b, *a) < 0) swap_elements(a, b);
+}
 
-size_t vector_binary_search(Vector vector, void *data, cmpFunc cmp)
+// Move element at root of the heap of n elements down until its children are not greater than it
+static void sift_down(void **heap, size_t root, size_t n, cmpFunc cmp)
 {
-    if (!cmp)
+    void *elem = heap[root];
+
+    for (size_t child; (child = 2 * root + 1) < n; root = child)
     {
-        vector->flag = ARG;
-        return __SIZE_MAX__;
+        // Pick the greater child
+        if (child + 1 < n && cmp(heap[child], heap[child + 1]) < 0)
+            child++;
+
+        if (cmp(heap[child], elem) <= 0)
+            break;
+
+        heap[root] = heap[child];
+    }
+
+    heap[root] = elem;
+}
+
+// Sort range from begin to end by heapsort
+static void heapsort(void **begin, void **end, cmpFunc cmp)
+{
+    size_t n = end - begin;
+
+    for (size_t i = n / 2; i-- > 0; )
+        sift_down(begin, i, n, cmp);
+
+    // Move the greatest element of the heap to its end and shrink the heap
+    for (size_t i = n; i-- > 1; )
+    {
+        swap_elements(begin, begin + i);
+        sift_down(begin, 0, i, cmp);
+    }
+}
+
+// Partition range from begin to end around the pivot at begin, placing elements equal to the pivot on its right
+// Return final position of the pivot and set already_partitioned to true if no elements had to be swapped
+// The range must hold an element that's not smaller than the pivot after it
+static void **partition_right(void **begin, void **end, cmpFunc cmp, bool *already_partitioned)
+{
+    void *pivot = *begin;
+    void **first = begin;
+    void **last = end;
+
+    // Find first element not smaller than the pivot, which exists
+    while (cmp(*++first, pivot) < 0);
+
+    // Find last element smaller than the pivot, checking bounds only if no element before first can stop the search
+    if (first - 1 == begin)
+        while (first < last && !(cmp(*--last, pivot) < 0));
+    else
+        while (!(cmp(*--last, pivot) < 0));
+
+    *already_partitioned = first >= last;
+
+    // Swap elements on the wrong side, every swap leaves a sentinel for the searches that follow it
+    while (first < last)
+    {
+        swap_elements(first, last);
+        while (cmp(*++first, pivot) < 0);
+        while (!(cmp(*--last, pivot) < 0));
+    }
+
+    // Put pivot between the two sides
+    void **pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+
+    return pivot_pos;
+}
+
+// Partition range from begin to end around the pivot at begin, placing elements equal to the pivot on its left
+// Return final position of the pivot
+// Used when the element before the range is equal to the pivot, so no element in range is smaller than it
+static void **partition_left(void **begin, void **end, cmpFunc cmp)
+{
+    void *pivot = *begin;
+    void **first = begin;
+    void **last = end;
+
+    while (cmp(pivot, *--last) < 0);
+
+    if (last + 1 == end)
+        while (first < last && !(cmp(pivot, *++first) < 0));
+    else
+        while (!(cmp(pivot, *++first) < 0));
+
+    while (first < last)
+    {
+        swap_elements(first, last);
+        while (cmp(pivot, *--last) < 0);
+        while (!(cmp(pivot, *++first) < 0));
+    }
+
+    void **pivot_pos = last;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+
+    return pivot_pos;
+}
+
+// Swap some elements of a range that was split badly with others a quarter of the way in, to break its pattern
+static void break_pattern(void **begin, void **end)
+{
+    size_t size = end - begin;
+    if (size < INSERTION_SORT_MAX) return;
+
+    size_t quarter = size / 4;
+
+    swap_elements(begin, begin + quarter);
+    swap_elements(end - 1, end - quarter);
+
+    if (size > NINTHER_MIN)
+    {
+        swap_elements(begin + 1, begin + quarter + 1);
+        swap_elements(begin + 2, begin + quarter + 2);
+        swap_elements(end - 2, end - quarter - 1);
+        swap_elements(end - 3, end - quarter - 2);
     }
+}
 
-    if (!vector->size) return __SIZE_MAX__;
+// Move pivot for range from begin to end to its start, as the median of three elements or of three medians of three
+// Leaves an element not smaller than the pivot at the end of the range, as partition_right requires
+static inline void choose_pivot(void **begin, void **end, cmpFunc cmp)
+{
+    size_t size = end - begin;
+    size_t half = size / 2;
 
-    // Start and end of the array currently being searched
-    size_t low = 0;
-    size_t high = vector->size - 1;
+    if (size > NINTHER_MIN)
+    {
+        sort3(begin, begin + half, end - 1, cmp);
+        sort3(begin + 1, begin + half - 1, end - 2, cmp);
+        sort3(begin + 2, begin + half + 1, end - 3, cmp);
+        sort3(begin + half - 1, begin + half, begin + half + 1, cmp);
+        swap_elements(begin, begin + half);
+    }
+    else sort3(begin + half, begin, end - 1, cmp);
+}
 
-    while(low < high)
+// Sort range from begin to end by pattern-defeating quicksort
+// Switch to heapsort after bad_allowed more bad partitions
+// If range is not leftmost, the element before it is not greater than any element in range
+static void pdqsort(void **begin, void **end, cmpFunc cmp, int bad_allowed, bool leftmost)
+{
+    while (true)
     {
-        // Find middle index and compare element with data
-        size_t middle = low + (high - low) / 2;
-        int cmp_factor = cmp(data, vector->array[middle]);
+        size_t size = end - begin;
+
+        // Small ranges are sorted by insertion sort
+        if (size < INSERTION_SORT_MAX)
+        {
+            if (leftmost) insertion_sort(begin, end, cmp);
+            else unguarded_insertion_sort(begin, end, cmp);
+            return;
+        }
+
+        // Move median to the start of the range, where it's used as the pivot
+        choose_pivot(begin, end, cmp);
+
+        // If the element before the range is equal to the pivot, the pivot is the smallest element of the range
+        // Elements equal to it are put on its left and never need sorting again
+        if (!leftmost && !(cmp(begin[-1], *begin) < 0))
+        {
+            begin = partition_left(begin, end, cmp) + 1;
+            continue;
+        }
+
+        bool already_partitioned;
+        void **pivot_pos = partition_right(begin, end, cmp, &already_partitioned);
+
+        size_t left_size = pivot_pos - begin;
+        size_t right_size = end - (pivot_pos + 1);
 
-        // If they're the same, return that index
-        if (!cmp_factor)
-            return middle;
+        if (left_size < size / 8 || right_size < size / 8)
+        {
+            // Too many bad partitions means that pivots are being picked badly, heapsort is used instead
+            if (--bad_allowed == 0)
+            {
+                heapsort(begin, end, cmp);
+                return;
+            }
+
+            break_pattern(begin, pivot_pos);
+            break_pattern(pivot_pos + 1, end);
+        }
+        else if (already_partitioned && partial_insertion_sort(begin, pivot_pos, cmp) && partial_insertion_sort(pivot_pos + 1, end, cmp))
+        {
+            // Both sides were almost sorted already
+            return;
+        }
 
-        // If data is smaller, search left subarray
-        if (cmp_factor < 0)
-            high = middle - 1;
-        // If data is bigger, search right subarray
+        // Sort smaller side recursively and continue with the larger one
+        if (left_size < right_size)
+        {
+            pdqsort(begin, pivot_pos, cmp, bad_allowed, leftmost);
+            begin = pivot_pos + 1;
+            leftmost = false;
+        }
         else
-            low = middle + 1;
+        {
+            pdqsort(pivot_pos + 1, end, cmp, bad_allowed, false);
+            end = pivot_pos;
+        }
     }
+}
 
-    // If array has one element, check if it is equal to data
-    if (low == high)
-        if (!cmp(data, vector->array[low]))
-            return low;
-    
-    return __SIZE_MAX__;
+// Return number of bad partitions allowed before sorting n elements with heapsort, about log2(n)
+static int bad_partitions(size_t n)
+{
+    int bad_allowed = 0;
+
+    for (size_t i = n; i > 1; i /= 2)
+        bad_allowed++;
+
+    return bad_allowed;
 }
 
-bool vector_insert_sorted(Vector vector, void *data, cmpFunc cmp)
+// Sort n elements of array, return after a single pass if they are already sorted or in strictly descending order
+static void sort_array(void **array, size_t n, cmpFunc cmp)
 {
-    ERR_FUNC(vector, cmp)
+    if (n < 2) return;
 
-    // If array doesn't contain other elements, simply insert element
-    if (!vector->size)
-        return vector_append(vector, data);
+    // Find the run at the start of the array
+    size_t run = 1;
 
-    // Perform binary search until array that is being searched has size 1
-    size_t low = 0;
-    size_t high = vector->size - 1;
+    if (cmp(array[1], array[0]) < 0)
+    {
+        while (run < n && cmp(array[run], array[run - 1]) < 0)
+            run++;
 
-    while(low < high)
+        // Descending elements are all distinct, so reversing them sorts them
+        if (run == n)
+        {
+            for (size_t i = 0; i < n / 2; i++)
+                swap_elements(array + i, array + n - 1 - i);
+            return;
+        }
+    }
+    else
     {
-        size_t middle = low + (high - low) / 2;
-        int cmp_factor = cmp(data, vector->array[middle]);
+        while (run < n && !(cmp(array[run], array[run - 1]) < 0))
+            run++;
+
+        if (run == n) return;
+    }
+
+    pdqsort(array, array + n, cmp, bad_partitions(n), true);
+}
+
+bool vector_sort(Vector vector, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+
+    sort_array(vector->array, vector->size, cmp);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////// HELPER FUNCTIONS FOR PARALLEL SORTING /////////////////////////////
+
+// vector_sort_parallel splits the array into one chunk per thread and sorts the chunks at once.
+// Sorted runs are then merged in pairs, one round at a time, between the array and a buffer. Every
+// merge is split into pieces of equal size by searching both runs for where each piece starts, so
+// all threads take part in every round, including the last one that merges only two runs.
 
-        if (!cmp_factor)
-            return vector_insert(vector, data, middle);
+#define PARALLEL_SORT_MIN 65536     // Vectors with fewer elements are always sorted by one thread
+#define MERGE_TASKS_PER_THREAD 4    // Merges are split into more pieces than threads so that threads finish together
 
-        if (cmp_factor < 0)
-            high = middle ? middle - 1 : middle;
+// State shared by the tasks of parallel sorting
+typedef struct sort_job
+{
+    void **src;           // Array that holds the runs
+    void **dst;           // Array runs are merged into
+    size_t *bounds;       // Run i goes from bounds[i] to bounds[i + 1]
+    size_t runs;          // Number of runs
+    size_t pieces;        // Number of pieces every merge is split into
+    cmpFunc cmp;
+}
+sort_job;
+
+// Sort run number task
+static void sort_run(void *ctx, size_t task)
+{
+    sort_job *job = ctx;
+    sort_array(job->src + job->bounds[task], job->bounds[task + 1] - job->bounds[task], job->cmp);
+}
+
+// Return how many of the first k elements of the merge of a and b come from a
+// Elements of a are placed before equal elements of b
+static size_t merge_split(void **a, size_t a_size, void **b, size_t b_size, size_t k, cmpFunc cmp)
+{
+    size_t low = k > b_size ? k - b_size : 0;
+    size_t high = k < a_size ? k : a_size;
+
+    while (low < high)
+    {
+        size_t i = low + (high - low) / 2;
+
+        // If a[i] is not greater than b[k-i-1], it's among the first k elements too
+        if (cmp(b[k - i - 1], a[i]) >= 0)
+            low = i + 1;
         else
-            low = middle + 1;
+            high = i;
     }
-    
-    // Compare data with element in that array
-    int cmp_factor = cmp(data, vector->array[low]);
 
-    // If it's bigger add it after element
-    if (cmp_factor > 0)
+    return low;
+}
+
+// Merge one piece of a pair of runs, task is the number of the pair times the number of pieces plus the piece
+// A run without a pair is copied as it is
+static void merge_piece(void *ctx, size_t task)
+{
+    sort_job *job = ctx;
+
+    size_t pair = task / job->pieces;
+    size_t piece = task % job->pieces;
+
+    size_t start = job->bounds[2 * pair];
+    size_t middle = job->bounds[2 * pair + 1];
+    size_t end = 2 * pair + 2 <= job->runs ? job->bounds[2 * pair + 2] : middle;
+
+    void **a = job->src + start, **b = job->src + middle;
+    size_t a_size = middle - start, b_size = end - middle;
+
+    // Find the part of both runs that makes up this piece of the output
+    size_t total = a_size + b_size;
+    size_t k_start = total * piece / job->pieces;
+    size_t k_end = total * (piece + 1) / job->pieces;
+
+    size_t i = merge_split(a, a_size, b, b_size, k_start, job->cmp);
+    size_t i_end = merge_split(a, a_size, b, b_size, k_end, job->cmp);
+    size_t j = k_start - i, j_end = k_end - i_end;
+
+    void **out = job->dst + start + k_start;
+
+    while (i < i_end && j < j_end)
     {
-        if (low == vector->size - 1)
-            return vector_append(vector, data);
+        if (job->cmp(b[j], a[i]) < 0)
+            *out++ = b[j++];
         else
-            return vector_insert(vector, data, low+1);
+            *out++ = a[i++];
+    }
+
+    memcpy(out, a + i, (i_end - i) * sizeof(void *));
+    out += i_end - i;
+    memcpy(out, b + j, (j_end - j) * sizeof(void *));
+}
+
+// Sort n elements of array on threads threads, fall back to one thread if memory can't be allocated
+static void sort_parallel(void **array, size_t n, cmpFunc cmp, size_t threads)
+{
+    void **buffer = malloc(n * sizeof(void *));
+    size_t *bounds = malloc((threads + 1) * sizeof(size_t));
+
+    if (!buffer || !bounds)
+    {
+        free(buffer); free(bounds);
+        sort_array(array, n, cmp);
+        return;
+    }
+
+    for (size_t i = 0; i <= threads; i++)
+        bounds[i] = n * i / threads;
+
+    sort_job job = {.src = array, .dst = buffer, .bounds = bounds, .runs = threads, .cmp = cmp};
+
+    // Sort a chunk on every thread
+    threadpool_run(threads, threads, sort_run, &job);
+
+    // Merge runs in pairs until one is left
+    while (job.runs > 1)
+    {
+        size_t pairs = (job.runs + 1) / 2;
+
+        job.pieces = (threads * MERGE_TASKS_PER_THREAD + pairs - 1) / pairs;
+        threadpool_run(pairs * job.pieces, threads, merge_piece, &job);
+
+        // Every merged run starts where the first run of its pair started
+        for (size_t i = 0; i < pairs; i++)
+            bounds[i] = bounds[2 * i];
+
+        bounds[pairs] = n;
+        job.runs = pairs;
+
+        void **temp = job.src;
+        job.src = job.dst;
+        job.dst = temp;
+    }
+
+    if (job.src != array)
+        memcpy(array, job.src, n * sizeof(void *));
+
+    free(buffer);
+    free(bounds);
+}
+
+bool vector_sort_parallel(Vector vector, cmpFunc cmp, size_t nthreads)
+{
+    ERR_FUNC(vector, cmp)
+
+    // Small vectors are sorted before the pool is asked for its threads, which would start it
+    if (nthreads <= 1 || vector->size < PARALLEL_SORT_MIN)
+    {
+        sort_array(vector->array, vector->size, cmp);
+        return true;
     }
-    // If it's smaller add it before
-    else return vector_insert(vector, data, low);
 
+    size_t available = threadpool_threads();
+    size_t threads = nthreads < available ? nthreads : available;
 
+    if (threads <= 1)
+        sort_array(vector->array, vector->size, cmp);
+    else
+        sort_parallel(vector->array, vector->size, cmp, threads);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////// HELPER FUNCTIONS FOR RADIX SORT ////////////////////////////////
+
+#define RADIX_BITS 8                                // Number of key bits sorted per pass
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+#define RADIX_SORT_MIN 64                           // Vectors with fewer elements are sorted by insertion sort
+
+// Element paired with its key, so that the key function is called once per element
+typedef struct keyed
+{
+    uint64_t key;
+    void *elem;
+}
+keyed;
+
+// Sort n pairs by key with insertion sort, pairs with equal keys keep their order
+static void keyed_insertion_sort(keyed *pairs, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        keyed pair = pairs[i];
+        size_t j = i;
+
+        for (; j > 0 && pair.key < pairs[j - 1].key; j--)
+            pairs[j] = pairs[j - 1];
+
+        pairs[j] = pair;
+    }
 }
 
+// Sort n pairs by key with LSD radix sort, using buffer of n pairs, and return the array that holds the result
+// Counts of every pass are taken in one go, and passes where all keys have the same digit are skipped
+static keyed *keyed_radix_sort(keyed *pairs, keyed *buffer, size_t n)
+{
+    size_t (*counts)[RADIX_BUCKETS] = calloc(RADIX_PASSES, sizeof(*counts));
+    if (!counts) return NULL;
+
+    for (size_t i = 0; i < n; i++)
+        for (int pass = 0; pass < RADIX_PASSES; pass++)
+            counts[pass][(pairs[i].key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++)
+    {
+        size_t *count = counts[pass];
+        int shift = pass * RADIX_BITS;
+
+        // If every key has the same digit, the pass wouldn't move anything
+        if (count[(pairs[0].key >> shift) & (RADIX_BUCKETS - 1)] == n)
+            continue;
+
+        // Turn counts into the position where every digit starts
+        size_t offset = 0;
+
+        for (int digit = 0; digit < RADIX_BUCKETS; digit++)
+        {
+            size_t temp = count[digit];
+            count[digit] = offset;
+            offset += temp;
+        }
+
+        for (size_t i = 0; i < n; i++)
+            buffer[count[(pairs[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = pairs[i];
+
+        keyed *temp = pairs;
+        pairs = buffer;
+        buffer = temp;
+    }
+
+    free(counts);
+    return pairs;
+}
+
+bool vector_sort_by_u64_key(Vector vector, keyFunc key)
+{
+    ERR_FUNC(vector, key)
+
+    size_t n = vector->size;
+    if (n < 2) return true;
+
+    keyed *pairs = malloc((n < RADIX_SORT_MIN ? n : 2 * n) * sizeof(keyed));
+    ERR_ALLOC(vector, pairs)
+
+    // Extract every key once, checking if keys are already in order
+    bool in_order = true;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        pairs[i].key = key(vector->array[i]);
+        pairs[i].elem = vector->array[i];
+
+        if (i && pairs[i].key < pairs[i - 1].key)
+            in_order = false;
+    }
+
+    if (in_order)
+    {
+        free(pairs);
+        return true;
+    }
+
+    keyed *sorted = pairs;
+
+    if (n < RADIX_SORT_MIN)
+        keyed_insertion_sort(pairs, n);
+    else
+        sorted = keyed_radix_sort(pairs, pairs + n, n);
+
+    if (!sorted)
+    {
+        free(pairs);
+        vector->flag = ALLOC;
+        return false;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        vector->array[i] = sorted[i].elem;
+
+    free(pairs);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////// HELPER FUNCTIONS FOR STABLE SORTING ///////////////////////////////
+
+// vector_stable_sort is a TimSort. The array is split into runs that are already in order, and
+// short runs are extended with binary insertion sort. Runs are kept on a stack and merged so that
+// their lengths shrink at least as fast as the Fibonacci numbers, which keeps merges balanced.
+// When one run keeps winning during a merge, the merge switches to galloping: it searches the other
+// run for where the winning element goes and copies everything before it at once. All merges share
+// one buffer of half the array, which is only allocated if the array is not a single run.
+
+#define MIN_MERGE 32          // Arrays with fewer elements are sorted by binary insertion sort
+#define MIN_GALLOP 7          // Number of consecutive wins by one run after which a merge starts galloping
+#define MAX_RUNS 85           // Maximum number of runs on the stack, enough for any array
+
+// Run of elements that are in order
+typedef struct tim_run
+{
+    size_t start;
+    size_t len;
+}
+tim_run;
+
+// State of a stable sort
+typedef struct timsort
+{
+    void **array;
+    void **buffer;            // Holds the smaller run of every merge
+    ptrdiff_t min_gallop;     // Current number of wins after which merges gallop, adapts to the data
+    cmpFunc cmp;
+    tim_run runs[MAX_RUNS];   // Stack of runs waiting to be merged
+    size_t nruns;
+}
+timsort;
+
+// Return length of the run at the start of the n elements of array, reversing it if it's descending
+// Only strictly descending runs are reversed, so that equal elements keep their order
+static size_t count_run(void **array, size_t n, cmpFunc cmp)
+{
+    if (n < 2) return n;
+
+    size_t run = 2;
+
+    if (cmp(array[1], array[0]) < 0)
+    {
+        while (run < n && cmp(array[run], array[run - 1]) < 0)
+            run++;
+
+        for (size_t i = 0; i < run / 2; i++)
+            swap_elements(array + i, array + run - 1 - i);
+    }
+    else
+    {
+        while (run < n && !(cmp(array[run], array[run - 1]) < 0))
+            run++;
+    }
+
+    return run;
+}
+
+// Sort n elements of array by binary insertion sort, where the first start elements are already sorted
+// Elements are placed after the elements equal to them
+static void binary_insertion_sort(void **array, size_t n, size_t start, cmpFunc cmp)
+{
+    for (size_t i = start; i < n; i++)
+    {
+        void *elem = array[i];
+        size_t low = 0, high = i;
+
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+
+            if (cmp(elem, array[middle]) < 0)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+
+        memmove(array + low + 1, array + low, (i - low) * sizeof(void *));
+        array[low] = elem;
+    }
+}
+
+// Return minimum length of runs for an array of n elements
+// Chosen so that n divided by it is a power of two or slightly less, which balances the merges
+static size_t min_run_length(size_t n)
+{
+    size_t extra = 0;
+
+    while (n >= MIN_MERGE)
+    {
+        extra |= n & 1;
+        n >>= 1;
+    }
+
+    return n + extra;
+}
+
+// Return position in sorted array of n elements where key would go before every element equal to it
+// Search starts from hint and moves away from it in growing steps, then finishes with a binary search
+static size_t gallop_left(void *key, void **array, size_t n, size_t hint, cmpFunc cmp)
+{
+    ptrdiff_t last = 0, offset = 1;
+
+    if (cmp(key, array[hint]) > 0)
+    {
+        // Key goes after hint, search to the right until array[hint + last] < key <= array[hint + offset]
+        ptrdiff_t max_offset = n - hint;
+
+        while (offset < max_offset && cmp(key, array[hint + offset]) > 0)
+        {
+            last = offset;
+            offset = 2 * offset + 1;
+        }
+
+        if (offset > max_offset) offset = max_offset;
+
+        last += hint;
+        offset += hint;
+    }
+    else
+    {
+        // Key goes at hint or before it, search to the left until array[hint - offset] < key <= array[hint - last]
+        ptrdiff_t max_offset = hint + 1;
+
+        while (offset < max_offset && cmp(key, array[hint - offset]) <= 0)
+        {
+            last = offset;
+            offset = 2 * offset + 1;
+        }
+
+        if (offset > max_offset) offset = max_offset;
+
+        ptrdiff_t temp = last;
+        last = hint - offset;
+        offset = hint - temp;
+    }
+
+    // Key goes after position last and at position offset at the latest
+    last++;
+
+    while (last < offset)
+    {
+        ptrdiff_t middle = last + (offset - last) / 2;
+
+        if (cmp(key, array[middle]) > 0)
+            last = middle + 1;
+        else
+            offset = middle;
+    }
+
+    return offset;
+}
+
+// Return position in sorted array of n elements where key would go after every element equal to it
+// Search works like gallop_left
+static size_t gallop_right(void *key, void **array, size_t n, size_t hint, cmpFunc cmp)
+{
+    ptrdiff_t last = 0, offset = 1;
+
+    if (cmp(key, array[hint]) < 0)
+    {
+        ptrdiff_t max_offset = hint + 1;
+
+        while (offset < max_offset && cmp(key, array[hint - offset]) < 0)
+        {
+            last = offset;
+            offset = 2 * offset + 1;
+        }
+
+        if (offset > max_offset) offset = max_offset;
+
+        ptrdiff_t temp = last;
+        last = hint - offset;
+        offset = hint - temp;
+    }
+    else
+    {
+        ptrdiff_t max_offset = n - hint;
+
+        while (offset < max_offset && cmp(key, array[hint + offset]) >= 0)
+        {
+            last = offset;
+            offset = 2 * offset + 1;
+        }
+
+        if (offset > max_offset) offset = max_offset;
+
+        last += hint;
+        offset += hint;
+    }
+
+    last++;
+
+    while (last < offset)
+    {
+        ptrdiff_t middle = last + (offset - last) / 2;
+
+        if (cmp(key, array[middle]) < 0)
+            offset = middle;
+        else
+            last = middle + 1;
+    }
+
+    return offset;
+}
+
+// Merge run of len1 elements at base1 with the run of len2 elements that follows it, where len1 <= len2
+// First run is moved to the buffer and the merge fills the array from the left
+// First element of the second run goes before the first run and last element of the first run after the second
+static void merge_low(timsort *ts, size_t base1, size_t len1, size_t base2, size_t len2)
+{
+    void **array = ts->array, **buffer = ts->buffer;
+    cmpFunc cmp = ts->cmp;
+
+    memcpy(buffer, array + base1, len1 * sizeof(void *));
+
+    size_t cursor1 = 0, cursor2 = base2, dest = base1;
+    ptrdiff_t min_gallop = ts->min_gallop;
+
+    array[dest++] = array[cursor2++];
+
+    if (--len2 == 0)
+    {
+        memcpy(array + dest, buffer + cursor1, len1 * sizeof(void *));
+        return;
+    }
+
+    if (len1 == 1)
+    {
+        memmove(array + dest, array + cursor2, len2 * sizeof(void *));
+        array[dest + len2] = buffer[cursor1];
+        return;
+    }
+
+    while (true)
+    {
+        size_t count1 = 0, count2 = 0;
+
+        // Merge one element at a time until one run wins often enough
+        do
+        {
+            if (cmp(array[cursor2], buffer[cursor1]) < 0)
+            {
+                array[dest++] = array[cursor2++];
+                count2++; count1 = 0;
+                if (--len2 == 0) goto done;
+            }
+            else
+            {
+                array[dest++] = buffer[cursor1++];
+                count1++; count2 = 0;
+                if (--len1 == 1) goto done;
+            }
+        }
+        while ((ptrdiff_t) (count1 | count2) < min_gallop);
+
+        // Gallop until neither run wins by a long stretch
+        do
+        {
+            count1 = gallop_right(array[cursor2], buffer + cursor1, len1, 0, cmp);
+
+            if (count1)
+            {
+                memcpy(array + dest, buffer + cursor1, count1 * sizeof(void *));
+                dest += count1; cursor1 += count1; len1 -= count1;
+                if (len1 <= 1) goto done;
+            }
+
+            array[dest++] = array[cursor2++];
+            if (--len2 == 0) goto done;
+
+            count2 = gallop_left(buffer[cursor1], array + cursor2, len2, 0, cmp);
+
+            if (count2)
+            {
+                memmove(array + dest, array + cursor2, count2 * sizeof(void *));
+                dest += count2; cursor2 += count2; len2 -= count2;
+                if (len2 == 0) goto done;
+            }
+
+            array[dest++] = buffer[cursor1++];
+            if (--len1 == 1) goto done;
+
+            min_gallop--;
+        }
+        while (count1 >= MIN_GALLOP || count2 >= MIN_GALLOP);
+
+        // Galloping stopped paying off, so it's made harder to start again
+        if (min_gallop < 0) min_gallop = 0;
+        min_gallop += 2;
+    }
+
+done:
+    ts->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+
+    // Either the last element of the first run is left and goes after the rest of the second,
+    // or the second run is used up and the rest of the first is copied back
+    if (len1 == 1)
+    {
+        memmove(array + dest, array + cursor2, len2 * sizeof(void *));
+        array[dest + len2] = buffer[cursor1];
+    }
+    else memcpy(array + dest, buffer + cursor1, len1 * sizeof(void *));
+}
+
+// Merge run of len1 elements at base1 with the run of len2 elements that follows it, where len1 > len2
+// Second run is moved to the buffer and the merge fills the array from the right
+static void merge_high(timsort *ts, size_t base1, size_t len1, size_t base2, size_t len2)
+{
+    void **array = ts->array, **buffer = ts->buffer;
+    cmpFunc cmp = ts->cmp;
+
+    memcpy(buffer, array + base2, len2 * sizeof(void *));
+
+    ptrdiff_t cursor1 = base1 + len1 - 1, cursor2 = len2 - 1, dest = base2 + len2 - 1;
+    ptrdiff_t min_gallop = ts->min_gallop;
+
+    array[dest--] = array[cursor1--];
+
+    if (--len1 == 0)
+    {
+        memcpy(array + dest - (len2 - 1), buffer, len2 * sizeof(void *));
+        return;
+    }
+
+    if (len2 == 1)
+    {
+        dest -= len1; cursor1 -= len1;
+        memmove(array + dest + 1, array + cursor1 + 1, len1 * sizeof(void *));
+        array[dest] = buffer[cursor2];
+        return;
+    }
+
+    while (true)
+    {
+        size_t count1 = 0, count2 = 0;
+
+        do
+        {
+            if (cmp(buffer[cursor2], array[cursor1]) < 0)
+            {
+                array[dest--] = array[cursor1--];
+                count1++; count2 = 0;
+                if (--len1 == 0) goto done;
+            }
+            else
+            {
+                array[dest--] = buffer[cursor2--];
+                count2++; count1 = 0;
+                if (--len2 == 1) goto done;
+            }
+        }
+        while ((ptrdiff_t) (count1 | count2) < min_gallop);
+
+        do
+        {
+            count1 = len1 - gallop_right(buffer[cursor2], array + base1, len1, len1 - 1, cmp);
+
+            if (count1)
+            {
+                dest -= count1; cursor1 -= count1; len1 -= count1;
+                memmove(array + dest + 1, array + cursor1 + 1, count1 * sizeof(void *));
+                if (len1 == 0) goto done;
+            }
+
+            array[dest--] = buffer[cursor2--];
+            if (--len2 == 1) goto done;
+
+            count2 = len2 - gallop_left(array[cursor1], buffer, len2, len2 - 1, cmp);
+
+            if (count2)
+            {
+                dest -= count2; cursor2 -= count2; len2 -= count2;
+                memcpy(array + dest + 1, buffer + cursor2 + 1, count2 * sizeof(void *));
+                if (len2 <= 1) goto done;
+            }
+
+            array[dest--] = array[cursor1--];
+            if (--len1 == 0) goto done;
+
+            min_gallop--;
+        }
+        while (count1 >= MIN_GALLOP || count2 >= MIN_GALLOP);
+
+        if (min_gallop < 0) min_gallop = 0;
+        min_gallop += 2;
+    }
+
+done:
+    ts->min_gallop = min_gallop < 1 ? 1 : min_gallop;
+
+    // Either the first element of the second run is left and goes before the rest of the first,
+    // or the first run is used up and the rest of the second is copied back
+    if (len2 == 1)
+    {
+        dest -= len1; cursor1 -= len1;
+        memmove(array + dest + 1, array + cursor1 + 1, len1 * sizeof(void *));
+        array[dest] = buffer[cursor2];
+    }
+    else memcpy(array + dest - (len2 - 1), buffer, len2 * sizeof(void *));
+}
+
+// Merge runs i and i + 1 of the stack
+static void merge_at(timsort *ts, size_t i)
+{
+    size_t base1 = ts->runs[i].start, len1 = ts->runs[i].len;
+    size_t base2 = ts->runs[i + 1].start, len2 = ts->runs[i + 1].len;
+
+    ts->runs[i].len = len1 + len2;
+
+    if (i == ts->nruns - 3)
+        ts->runs[i + 1] = ts->runs[i + 2];
+
+    ts->nruns--;
+
+    // Elements of the first run that are not greater than the start of the second are already in place
+    size_t skip = gallop_right(ts->array[base2], ts->array + base1, len1, 0, ts->cmp);
+    base1 += skip;
+    len1 -= skip;
+    if (!len1) return;
+
+    // So are elements of the second run that are not smaller than the end of the first
+    len2 = gallop_left(ts->array[base1 + len1 - 1], ts->array + base2, len2, len2 - 1, ts->cmp);
+    if (!len2) return;
+
+    if (len1 <= len2)
+        merge_low(ts, base1, len1, base2, len2);
+    else
+        merge_high(ts, base1, len1, base2, len2);
+}
+
+// Merge runs at the top of the stack until every run is longer than the two above it combined
+static void merge_collapse(timsort *ts)
+{
+    tim_run *runs = ts->runs;
+
+    while (ts->nruns > 1)
+    {
+        size_t n = ts->nruns - 2;
+
+        if ((n > 0 && runs[n - 1].len <= runs[n].len + runs[n + 1].len) ||
+            (n > 1 && runs[n - 2].len <= runs[n - 1].len + runs[n].len))
+        {
+            if (runs[n - 1].len < runs[n + 1].len)
+                n--;
+        }
+        else if (runs[n].len > runs[n + 1].len)
+            break;
+
+        merge_at(ts, n);
+    }
+}
+
+// Merge all runs on the stack into one
+static void merge_force_collapse(timsort *ts)
+{
+    while (ts->nruns > 1)
+    {
+        size_t n = ts->nruns - 2;
+
+        if (n > 0 && ts->runs[n - 1].len < ts->runs[n + 1].len)
+            n--;
+
+        merge_at(ts, n);
+    }
+}
+
+bool vector_stable_sort(Vector vector, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+
+    void **array = vector->array;
+    size_t n = vector->size;
+
+    if (n < 2) return true;
+
+    size_t run = count_run(array, n, cmp);
+
+    // Small arrays are sorted without merging
+    if (n < MIN_MERGE)
+    {
+        binary_insertion_sort(array, n, run, cmp);
+        return true;
+    }
+
+    if (run == n) return true;
+
+    timsort ts = {.array = array, .min_gallop = MIN_GALLOP, .cmp = cmp, .nruns = 0};
+
+    ts.buffer = malloc(n / 2 * sizeof(void *));
+    ERR_ALLOC(vector, ts.buffer)
+
+    size_t min_run = min_run_length(n);
+
+    for (size_t start = 0; start < n; start += run)
+    {
+        if (start) run = count_run(array + start, n - start, cmp);
+
+        // Extend short runs to the minimum length
+        if (run < min_run)
+        {
+            size_t forced = n - start < min_run ? n - start : min_run;
+            binary_insertion_sort(array + start, forced, run, cmp);
+            run = forced;
+        }
+
+        ts.runs[ts.nruns++] = (tim_run) {start, run};
+        merge_collapse(&ts);
+    }
+
+    merge_force_collapse(&ts);
+    free(ts.buffer);
+
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////// HELPER FUNCTIONS FOR SELECTION //////////////////////////////////
+
+// Place element that belongs at nth in sorted order there, with no greater elements before it and no smaller ones after it
+// Range is partitioned like in pdqsort, but only the side that holds nth is kept
+// Switch to heapsort after bad_allowed bad partitions
+static void select_nth(void **begin, void **end, void **nth, cmpFunc cmp, int bad_allowed)
+{
+    bool leftmost = true;
+
+    while (end - begin >= INSERTION_SORT_MAX)
+    {
+        size_t size = end - begin;
+        choose_pivot(begin, end, cmp);
+
+        // Elements equal to the pivot are gathered on its left, and nth is done if it's one of them
+        if (!leftmost && !(cmp(begin[-1], *begin) < 0))
+        {
+            void **pivot_pos = partition_left(begin, end, cmp);
+            if (nth <= pivot_pos) return;
+
+            begin = pivot_pos + 1;
+            continue;
+        }
+
+        bool already_partitioned;
+        void **pivot_pos = partition_right(begin, end, cmp, &already_partitioned);
+
+        if (pivot_pos == nth) return;
+
+        size_t left_size = pivot_pos - begin;
+        size_t right_size = end - (pivot_pos + 1);
+
+        if (left_size < size / 8 || right_size < size / 8)
+        {
+            if (--bad_allowed == 0)
+            {
+                heapsort(begin, end, cmp);
+                return;
+            }
+
+            break_pattern(begin, pivot_pos);
+            break_pattern(pivot_pos + 1, end);
+        }
+
+        // Keep searching the side that holds nth
+        if (nth < pivot_pos)
+            end = pivot_pos;
+        else
+        {
+            begin = pivot_pos + 1;
+            leftmost = false;
+        }
+    }
+
+    if (leftmost) insertion_sort(begin, end, cmp);
+    else unguarded_insertion_sort(begin, end, cmp);
+}
+
+bool vector_nth_element(Vector vector, size_t index, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+    ERR_BOUNDS(vector, index, vector->size)
+
+    void **array = vector->array;
+    select_nth(array, array + vector->size, array + index, cmp, bad_partitions(vector->size));
+
+    return true;
+}
+
+bool vector_partial_sort(Vector vector, size_t k, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+
+    void **array = vector->array;
+    size_t n = vector->size;
+
+    // Smallest k elements are moved to the front and then sorted
+    if (k < n)
+    {
+        if (!k) return true;
+        select_nth(array, array + n, array + k - 1, cmp, bad_partitions(n));
+    }
+    else k = n;
+
+    sort_array(array, k, cmp);
+    return true;
+}
+
+void **vector_top_k(Vector vector, size_t k, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+
+    if (!k)
+    {
+        vector->flag = ARG;
+        return NULL;
+    }
+
+    ERR_BOUNDS(vector, k, vector->size + 1)
+
+    void **heap = malloc(k * sizeof(void *));
+    ERR_ALLOC(vector, heap)
+
+    // Heap holds the k smallest elements seen so far, with the greatest of them at the root
+    memcpy(heap, vector->array, k * sizeof(void *));
+
+    for (size_t i = k / 2; i-- > 0; )
+        sift_down(heap, i, k, cmp);
+
+    // Every other element replaces the root if it's smaller
+    for (size_t i = k; i < vector->size; i++)
+    {
+        if (cmp(vector->array[i], heap[0]) < 0)
+        {
+            heap[0] = vector->array[i];
+            sift_down(heap, 0, k, cmp);
+        }
+    }
+
+    // Sort heap in place by moving the greatest element to its end each time
+    for (size_t i = k; i-- > 1; )
+    {
+        swap_elements(heap, heap + i);
+        sift_down(heap, 0, i, cmp);
+    }
+
+    return heap;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/////////////////////////////////// HELPER FUNCTIONS FOR SEARCHING ///////////////////////////////////
+
+// Searches below halve the range without branching on the result of cmp, so the loop runs the same
+// number of times for every key and the choice between halves compiles to a conditional move. Both
+// places the next comparison can land on are prefetched while the current one is made.
+
+// Return index of first of n elements of array that is not smaller than data, or n if there is none
+static size_t lower_bound(void **array, size_t n, void *data, cmpFunc cmp)
+{
+    if (!n) return 0;
+
+    void **base = array;
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+
+        base = cmp(base[half], data) < 0 ? base + half : base;
+        n -= half;
+    }
+
+    return (base - array) + (cmp(*base, data) < 0);
+}
+
+// Return index of first of n elements of array that is greater than data, or n if there is none
+static size_t upper_bound(void **array, size_t n, void *data, cmpFunc cmp)
+{
+    if (!n) return 0;
+
+    void **base = array;
+
+    while (n > 1)
+    {
+        size_t half = n / 2;
+
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+
+        base = cmp(base[half], data) <= 0 ? base + half : base;
+        n -= half;
+    }
+
+    return (base - array) + (cmp(*base, data) <= 0);
+}
+
+size_t vector_lower_bound(Vector vector, void *data, cmpFunc cmp)
+{
+    if (!cmp)
+    {
+        vector->flag = FUNC;
+        return __SIZE_MAX__;
+    }
+
+    return lower_bound(vector->array, vector->size, data, cmp);
+}
+
+size_t vector_upper_bound(Vector vector, void *data, cmpFunc cmp)
+{
+    if (!cmp)
+    {
+        vector->flag = FUNC;
+        return __SIZE_MAX__;
+    }
+
+    return upper_bound(vector->array, vector->size, data, cmp);
+}
+
+bool vector_equal_range(Vector vector, void *data, cmpFunc cmp, size_t *start, size_t *end)
+{
+    ERR_FUNC(vector, cmp)
+
+    // Elements equal to data can only follow the lower bound
+    size_t low = lower_bound(vector->array, vector->size, data, cmp);
+    size_t high = low + upper_bound(vector->array + low, vector->size - low, data, cmp);
+
+    if (start) *start = low;
+    if (end) *end = high;
+
+    return low < high;
+}
+
+size_t vector_binary_search(Vector vector, void *data, cmpFunc cmp)
+{
+    if (!cmp)
+    {
+        vector->flag = FUNC;
+        return __SIZE_MAX__;
+    }
+
+    size_t index = lower_bound(vector->array, vector->size, data, cmp);
+
+    if (index < vector->size && !cmp(data, vector->array[index]))
+        return index;
+
+    // Data is not in vector
+    vector->flag = ARG;
+    return __SIZE_MAX__;
+}
+
+bool vector_insert_sorted(Vector vector, void *data, cmpFunc cmp)
+{
+    ERR_FUNC(vector, cmp)
+
+    // Insert data after elements equal to it
+    size_t index = upper_bound(vector->array, vector->size, data, cmp);
+
+    if (index == vector->size)
+        return vector_append(vector, data);
+
+    return vector_insert(vector, data, index);
+}
+
+
+
+///////////////////////////////////// FUNCTIONS FOR EYTZINGER //////////////////////////////////////
+
+#define EYTZINGER_ALIGN 64          // Array of the layout is aligned to a cache line
+#define EYTZINGER_PREFETCH 8        // The 8 descendants three levels down fill a cache line, and are prefetched
+
+struct eytzinger
+{
+    void **tree;          // Elements in breadth-first order of a complete binary search tree, starting at index 1
+    size_t size;          // Number of elements
+};
+
+// Place elements of sorted array in tree by visiting the tree in order, starting at node k
+// Return index of the next element of array to place
+static size_t eytzinger_fill(void **array, void **tree, size_t n, size_t i, size_t k)
+{
+    if (k <= n)
+    {
+        i = eytzinger_fill(array, tree, n, i, 2 * k);
+        tree[k] = array[i++];
+        i = eytzinger_fill(array, tree, n, i, 2 * k + 1);
+    }
+
+    return i;
+}
+
+// Return node of the first element of tree that is not smaller than data, or 0 if there is none
+static size_t eytzinger_find(Eytzinger eytz, void *data, cmpFunc cmp)
+{
+    size_t k = 1;
+
+    // Go left if node is not smaller than data, right otherwise, until falling off the tree
+    while (k <= eytz->size)
+    {
+        // Index is checked before a pointer is formed from it, near the leaves it's past the end of the tree
+        size_t ahead = EYTZINGER_PREFETCH * k;
+        if (ahead <= eytz->size) __builtin_prefetch(eytz->tree + ahead);
+
+        k = 2 * k + (cmp(eytz->tree[k], data) < 0);
+    }
+
+    // Last left turn was taken at the answer, every right turn after it added a one bit
+    k >>= __builtin_ctzll(~(unsigned long long) k) + 1;
+
+    return k;
+}
+
+Eytzinger vector_eytzinger(Vector vector)
+{
+    Eytzinger eytz = malloc(sizeof(struct eytzinger));
+    ERR_ALLOC(vector, eytz)
+
+    // Size is rounded up to a whole number of cache lines
+    size_t bytes = (vector->size + 1) * sizeof(void *);
+    bytes = (bytes + EYTZINGER_ALIGN - 1) / EYTZINGER_ALIGN * EYTZINGER_ALIGN;
+
+    eytz->tree = aligned_alloc(EYTZINGER_ALIGN, bytes);
+
+    if (!eytz->tree)
+    {
+        free(eytz);
+        vector->flag = ALLOC;
+        return NULL;
+    }
+
+    eytz->size = vector->size;
+    eytzinger_fill(vector->array, eytz->tree, eytz->size, 0, 1);
+
+    return eytz;
+}
+
+size_t eytzinger_size(Eytzinger eytz)
+{
+    return eytz->size;
+}
+
+void *eytzinger_search(Eytzinger eytz, void *data, cmpFunc cmp)
+{
+    size_t k = eytzinger_find(eytz, data, cmp);
+
+    if (k && !cmp(data, eytz->tree[k]))
+        return eytz->tree[k];
+
+    return NULL;
+}
+
+void *eytzinger_lower_bound(Eytzinger eytz, void *data, cmpFunc cmp)
+{
+    size_t k = eytzinger_find(eytz, data, cmp);
+    return k ? eytz->tree[k] : NULL;
+}
+
+void eytzinger_destroy(Eytzinger eytz)
+{
+    free(eytz->tree);
+    free(eytz);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
 Vector vector_copy(Vector vector, copyFunc copy)
 {
     // Initialize new vector